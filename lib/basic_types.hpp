@@ -25,15 +25,15 @@ namespace ssz {
 // Type traits
 constexpr size_t size(basic_type auto i) noexcept { return sizeof(i); }
 
-// Serialization
-constexpr void serialize(std::weakly_incrementable auto result, const basic_type auto i)
+// Serialization, the in place functions return the end of the bytes written
+constexpr auto serialize(std::weakly_incrementable auto result, const basic_type auto i)
     requires std::is_same_v<decltype(*result), std::byte &>
 {
     if constexpr (std::endian::native == std::endian::big) {
         i = std::byteswap(i);
     }
-    std::copy(static_cast<const std::byte *>(static_cast<const void *>(&i)),
-              static_cast<const std::byte *>(static_cast<const void *>(&i)) + sizeof(i), result);
+    return std::copy(static_cast<const std::byte *>(static_cast<const void *>(&i)),
+                     static_cast<const std::byte *>(static_cast<const void *>(&i)) + sizeof(i), result);
 }
 constexpr auto serialize(const basic_type auto i) {
     std::vector<std::byte> ret(sizeof(i));
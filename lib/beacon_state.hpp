@@ -22,7 +22,9 @@
 #pragma once
 #include <cstdint>
 
+#include "cached_tree.hpp"
 #include "container.hpp"
+#include "persistent_list.hpp"
 #include "fork.hpp"
 #include "validator.hpp"
 #include "historical_summary.hpp"
@@ -42,6 +44,13 @@ constexpr std::size_t VALIDATOR_REGISTRY_LIMIT{1ull << 40};
 
 using participation_flags_t = std::uint8_t;
 
+/**
+ * \brief the Capella beacon state.
+ *
+ * Its large lists are cached_list, so that copies of a state share them until written to and a state rehashes only
+ * what changed since its last hash. The ring buffers indexed by slot or epoch are persistent_vector, whose writes
+ * through operator[], set() or update() copy O(log n) nodes instead of the whole vector in a copy of the state.
+ */
 struct beacon_state_t : ssz_variable_size_container {
     // Versioning
     std::uint64_t genesis_time;
@@ -51,8 +60,8 @@ struct beacon_state_t : ssz_variable_size_container {
 
     // History
     beacon_block_header_t latest_block_header;
-    std::array<Root, SLOTS_PER_HISTORICAL_ROOT> block_roots, state_roots;
-    ssz::list<Root, HISTORICAL_ROOTS_LIMIT> historical_roots;
+    ssz::persistent_vector<Root, SLOTS_PER_HISTORICAL_ROOT> block_roots, state_roots;
+    ssz::cached_list<Root, HISTORICAL_ROOTS_LIMIT> historical_roots;
 
     // Eth1
     eth1_data_t eth1_data;
@@ -60,17 +69,17 @@ struct beacon_state_t : ssz_variable_size_container {
     std::uint64_t eth1_deposit_index;
 
     // Registry
-    ssz::list<validator_t, VALIDATOR_REGISTRY_LIMIT> validators;
-    ssz::list<Gwei, VALIDATOR_REGISTRY_LIMIT> balances;
+    ssz::cached_list<validator_t, VALIDATOR_REGISTRY_LIMIT> validators;
+    ssz::cached_list<Gwei, VALIDATOR_REGISTRY_LIMIT> balances;
 
     // Randomness
-    std::array<Root, EPOCHS_PER_HISTORICAL_VECTOR> randao_mixes;
+    ssz::persistent_vector<Root, EPOCHS_PER_HISTORICAL_VECTOR> randao_mixes;
 
     // Slashings
-    std::array<Gwei, EPOCHS_PER_SLASHINGS_VECTOR> slashings;
+    ssz::persistent_vector<Gwei, EPOCHS_PER_SLASHINGS_VECTOR> slashings;
 
     // Participation
-    ssz::list<participation_flags_t, VALIDATOR_REGISTRY_LIMIT> previous_epoch_participation,
+    ssz::cached_list<participation_flags_t, VALIDATOR_REGISTRY_LIMIT> previous_epoch_participation,
         current_epoch_participation;
 
     // Finality
@@ -78,7 +87,7 @@ struct beacon_state_t : ssz_variable_size_container {
     checkpoint_t previous_justified_checkpoint, current_justified_checkpoint, finalized_checkpoint;
 
     // Inactivity
-    ssz::list<std::uint64_t, VALIDATOR_REGISTRY_LIMIT> inactivity_scores;
+    ssz::cached_list<std::uint64_t, VALIDATOR_REGISTRY_LIMIT> inactivity_scores;
 
     // Sync
     sync_committee_t current_sync_committee, next_sync_committee;
@@ -91,7 +100,7 @@ struct beacon_state_t : ssz_variable_size_container {
     ValidatorIndex next_withdrawal_validator_index;
 
     // Deep history valid from Capella onwards
-    ssz::list<historical_summary_t, HISTORICAL_ROOTS_LIMIT> historical_summaries;
+    ssz::cached_list<historical_summary_t, HISTORICAL_ROOTS_LIMIT> historical_summaries;
 
     constexpr auto operator<=>(const beacon_state_t& rhs) const noexcept = default;
     constexpr bool operator==(const beacon_state_t& rhs) const noexcept = default;
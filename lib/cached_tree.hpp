@@ -0,0 +1,258 @@
+/*  cached_tree.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#ifdef HAVE_YAML
+#include <yaml-cpp/yaml.h>
+#endif
+
+#include "container.hpp"
+#include "merkleize.hpp"
+
+namespace ssz {
+namespace _detail {
+/**
+ * \brief the elements of a cached_list or cached_vector together with their tree, shared between copies.
+ *
+ * Copies share the same node until one of them is written to, at which point the writer gets its own copy of the
+ * elements and of the tree, so that only the paths it changes are rehashed afterwards. Default constructed objects
+ * share a single empty node. The tree of a shared node is updated by one thread at a time, so that copies can be
+ * hashed from different threads; a copy hashed while another thread updates the tree is hashed without it.
+ */
+template <class Container, ssz_object T, std::size_t N>
+class shared_leaves {
+   private:
+    struct node {
+        Container elements{};
+        cached_leaves<T, N> cache{};
+        mutable update_flag updating{};
+
+        node() = default;
+        explicit node(Container&& elems) : elements{std::move(elems)} {}
+        node(const node& other) : elements{other.elements} {
+            // a cache that is being updated is not waited for, the copy starts with all its leaves dirty
+            std::unique_lock lock{other.updating, std::try_to_lock};
+            if (lock) cache = other.cache;
+        }
+    };
+    std::shared_ptr<node> m_node;
+
+    static const std::shared_ptr<node>& empty_node() {
+        static const auto empty = std::make_shared<node>();
+        return empty;
+    }
+
+    // the elements of a node owned by this object alone, leaves are not marked dirty
+    Container& unshared_elements() {
+        if (m_node.use_count() > 1) m_node = std::make_shared<node>(*m_node);
+        return m_node->elements;
+    }
+
+   public:
+    shared_leaves() : m_node{empty_node()} {}
+    explicit shared_leaves(Container&& elements) : m_node{std::make_shared<node>(std::move(elements))} {}
+
+    const Container& elements() const noexcept { return m_node->elements; }
+
+    Container& write(std::size_t idx) {
+        auto& ret = unshared_elements();
+        m_node->cache.mark_dirty(idx);
+        return ret;
+    }
+    Container& write_all() {
+        auto& ret = unshared_elements();
+        m_node->cache.mark_all_dirty();
+        return ret;
+    }
+
+    // the root of the elements on up to cpu_count threads, 0 meaning all available cores
+    chunk_t root(std::size_t cpu_count) const {
+        if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+        std::unique_lock lock{m_node->updating, std::try_to_lock};
+        if (!lock) return cached_leaves<T, N>{}.root(m_node->elements, cpu_count);
+        return m_node->cache.root(m_node->elements, cpu_count);
+    }
+    const merkle_tree& tree(std::size_t cpu_count) const {
+        if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+        std::lock_guard lock{m_node->updating};
+        return m_node->cache.tree(m_node->elements, cpu_count);
+    }
+    bool shares_with(const shared_leaves& other) const noexcept { return m_node == other.m_node; }
+};
+}  // namespace _detail
+
+/**
+ * \brief an ssz::list that keeps its Merkle tree between calls to hash_tree_root.
+ *
+ * Elements written through the non-const accessors are marked dirty and only their paths are rehashed. Non-const
+ * iteration or access to the underlying vector marks the whole list dirty, use std::as_const or set() to avoid it.
+ *
+ * Copies are cheap: they share the elements and the tree until one of them is written to. A reference obtained from a
+ * non-const accessor is only valid until the list is copied.
+ */
+template <ssz_object T, std::size_t N>
+    requires(!std::is_same_v<T, bool>)
+class cached_list {
+   private:
+    _detail::shared_leaves<std::vector<T>, T, N> m_leaves{};
+
+   public:
+    cached_list() = default;
+    cached_list(const std::vector<T>& list) : m_leaves{std::vector<T>{list}} {};
+    cached_list(std::vector<T>&& list) : m_leaves{std::move(list)} {};
+
+    auto begin() { return m_leaves.write_all().begin(); }
+    auto begin() const noexcept { return m_leaves.elements().begin(); }
+    auto cbegin() const noexcept { return m_leaves.elements().cbegin(); }
+    auto end() { return m_leaves.write_all().end(); }
+    auto end() const noexcept { return m_leaves.elements().end(); }
+    auto cend() const noexcept { return m_leaves.elements().cend(); }
+    auto size() const noexcept { return m_leaves.elements().size(); }
+    static constexpr auto limit() noexcept { return N; }
+    void reset(std::vector<T>& vec) { m_leaves = decltype(m_leaves){std::move(vec)}; }
+    void push_back(T&& value) { m_leaves.write(size()).push_back(std::move(value)); }
+    void push_back(const T& value) { m_leaves.write(size()).push_back(value); }
+    void set(std::size_t pos, const T& value) { m_leaves.write(pos)[pos] = value; }
+    auto& data() { return m_leaves.write_all(); }
+    auto& data() const noexcept { return m_leaves.elements(); }
+    auto root(std::size_t cpu_count = 0) const { return m_leaves.root(cpu_count); }
+    const auto& tree(std::size_t cpu_count = 0) const { return m_leaves.tree(cpu_count); }
+    // whether both lists still share their elements, in which case they are equal
+    bool shares_with(const cached_list& other) const noexcept { return m_leaves.shares_with(other.m_leaves); }
+
+    struct variable_size : std::true_type {};
+    using value_type = typename std::vector<T>::value_type;
+    using size_type = typename std::vector<T>::size_type;
+    using difference_type = typename std::vector<T>::difference_type;
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    auto& operator[](size_type pos) { return m_leaves.write(pos)[pos]; }
+    auto& operator[](size_type pos) const { return m_leaves.elements()[pos]; }
+
+    auto operator<=>(const cached_list& rhs) const noexcept { return data() <=> rhs.data(); }
+    bool operator==(const cached_list& rhs) const noexcept { return shares_with(rhs) || data() == rhs.data(); }
+};
+
+/**
+ * \brief a fixed size vector, modeled on std::array, that keeps its Merkle tree between calls to hash_tree_root.
+ *
+ * The same dirty tracking and sharing rules of cached_list apply, default constructed vectors share a single zero
+ * initialized array until written to.
+ */
+template <ssz_object T, std::size_t N>
+    requires(!std::is_same_v<T, bool>)
+class cached_vector {
+   private:
+    _detail::shared_leaves<std::array<T, N>, T, N> m_leaves{};
+
+   public:
+    auto begin() { return m_leaves.write_all().begin(); }
+    auto begin() const noexcept { return m_leaves.elements().begin(); }
+    auto cbegin() const noexcept { return m_leaves.elements().cbegin(); }
+    auto end() { return m_leaves.write_all().end(); }
+    auto end() const noexcept { return m_leaves.elements().end(); }
+    auto cend() const noexcept { return m_leaves.elements().cend(); }
+    static constexpr auto size() noexcept { return N; }
+    void set(std::size_t pos, const T& value) { m_leaves.write(pos)[pos] = value; }
+    auto& data() { return m_leaves.write_all(); }
+    auto& data() const noexcept { return m_leaves.elements(); }
+    auto root(std::size_t cpu_count = 0) const { return m_leaves.root(cpu_count); }
+    const auto& tree(std::size_t cpu_count = 0) const { return m_leaves.tree(cpu_count); }
+    // whether both vectors still share their elements, in which case they are equal
+    bool shares_with(const cached_vector& other) const noexcept { return m_leaves.shares_with(other.m_leaves); }
+
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = typename std::array<T, N>::iterator;
+    using const_iterator = typename std::array<T, N>::const_iterator;
+
+    auto& operator[](size_type pos) { return m_leaves.write(pos)[pos]; }
+    auto& operator[](size_type pos) const { return m_leaves.elements()[pos]; }
+
+    auto operator<=>(const cached_vector& rhs) const noexcept { return data() <=> rhs.data(); }
+    bool operator==(const cached_vector& rhs) const noexcept { return shares_with(rhs) || data() == rhs.data(); }
+};
+
+namespace _detail {
+template <ssz_object T, std::size_t N>
+struct list_traits<cached_list<T, N>> : list_traits<list<T, N>> {};
+
+template <ssz_object T, std::size_t N>
+struct vector_traits<cached_vector<T, N>> : vector_traits<std::array<T, N>> {};
+}  // namespace _detail
+
+// Deserialization
+template <ssz_object T, std::size_t N>
+void deserialize(const serialized_range auto& bytes, cached_list<T, N>& ret) {
+    deserialize(bytes, ret.data());
+}
+
+template <ssz_object T, std::size_t N>
+void deserialize(const serialized_range auto& bytes, cached_vector<T, N>& ret) {
+    deserialize(bytes, ret.data());
+}
+
+// hash_tree_root of cached lists and vectors
+template <ssz_object T, std::size_t N>
+void hash_tree_root(ssz_iterator auto result, const cached_list<T, N>& r, size_t cpu_count = 0, size_t = 0) {
+    mix_in_length(result, std::begin(r.root(cpu_count)), r.size());
+}
+
+template <ssz_object T, std::size_t N>
+auto hash_tree_root(const cached_list<T, N>& r, size_t cpu_count = 0) {
+    chunk_t ret{};
+    hash_tree_root(std::begin(ret), r, cpu_count);
+    return ret;
+}
+
+template <ssz_object T, std::size_t N>
+void hash_tree_root(ssz_iterator auto result, const cached_vector<T, N>& r, size_t cpu_count = 0, size_t = 0) {
+    std::ranges::copy(r.root(cpu_count), result);
+}
+
+template <ssz_object T, std::size_t N>
+auto hash_tree_root(const cached_vector<T, N>& r, size_t cpu_count = 0) {
+    return r.root(cpu_count);
+}
+}  // namespace ssz
+
+#ifdef HAVE_YAML
+template <ssz::ssz_object T, size_t N>
+struct YAML::convert<ssz::cached_list<T, N>> {
+    static bool decode(const YAML::Node& node, ssz::cached_list<T, N>& r) {
+        return YAML::convert<std::vector<T>>::decode(node, r.data());
+    }
+};
+
+template <ssz::ssz_object T, size_t N>
+struct YAML::convert<ssz::cached_vector<T, N>> {
+    static bool decode(const YAML::Node& node, ssz::cached_vector<T, N>& r) {
+        return YAML::convert<std::array<T, N>>::decode(node, r.data());
+    }
+};
+#endif
@@ -108,6 +108,10 @@ concept ssz_basic_type_vector =
     ssz_vector<C> &&
     (basic_type<typename C::value_type> || (std::is_array_v<C> && basic_type<std::remove_pointer_t<std::decay_t<C>>>) ||
      std::ranges::contiguous_range<C> && basic_type<std::remove_cvref_t<std::ranges::range_value_t<C>>>);
+// fixed size containers declared with SSZ_CONT, whose members can be visited
+template <class T>
+concept ssz_fixed_size_container = ssz_object_fixed_size<T> && requires(const T &t) { t.ssz_members(); };
+
 template <typename C>
 concept ssz_basic_type_array = ssz_basic_type_vector<C> && ssz_array<C>;
 }  // namespace ssz
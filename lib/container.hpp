@@ -25,8 +25,14 @@
 #include <yaml-cpp/yaml.h>
 #endif
 
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
 #include "concepts.hpp"
 #include "merkleize.hpp"
+#include "thread_pool.hpp"
 
 namespace ssz {
 
@@ -45,14 +51,28 @@ struct is_ssz_object<R> : std::true_type {};
 
 // Serialization
 #define SSZ_CONT(...)                                                                                      \
-    constexpr std::size_t ssz_size() const noexcept { return ssz::compute_total_length(__VA_ARGS__); }     \
-    constexpr void serialize(ssz::ssz_iterator auto result) const { ssz::serialize(result, __VA_ARGS__); } \
+    using ssz_members_t = decltype(std::tie(__VA_ARGS__));                                                \
+    static constexpr auto ssz_member_positions = ssz::_detail::member_positions<ssz_members_t>();          \
+    static constexpr std::size_t ssz_fixed_part_size = ssz_member_positions.back();                        \
+    static constexpr bool ssz_fixed_members = ssz::_detail::all_members_fixed_size<ssz_members_t>();       \
+    constexpr std::size_t ssz_size() const noexcept {                                                      \
+        if constexpr (ssz_fixed_members)                                                                   \
+            return ssz_fixed_part_size;                                                                    \
+        else                                                                                               \
+            return ssz::compute_total_length(__VA_ARGS__);                                                 \
+    }                                                                                                      \
+    constexpr auto serialize(ssz::ssz_iterator auto result) const {                                        \
+        return ssz::serialize_container(result, __VA_ARGS__);                                              \
+    }                                                                                                      \
     constexpr void deserialize(const std::ranges::sized_range auto &bytes) {                               \
         ssz::deserialize_container(bytes, __VA_ARGS__);                                                    \
     }                                                                                                      \
     void hash_tree_root(ssz::ssz_iterator auto result, size_t cpu_count = 0) const {                       \
         ssz::_container_hash(result, cpu_count, __VA_ARGS__);                                              \
-    }
+    }                                                                                                      \
+    constexpr auto ssz_members() const noexcept { return std::tie(__VA_ARGS__); }                          \
+    constexpr auto ssz_members() noexcept { return std::tie(__VA_ARGS__); }                                \
+    static constexpr std::string_view ssz_member_names() noexcept { return #__VA_ARGS__; }
 #ifdef HAVE_YAML
 #define YAML_CONT(...) \
     bool yaml_decode(const YAML::Node &node) { return ssz::yaml_decode_container(node, __VA_ARGS__); }
@@ -67,6 +87,70 @@ constexpr std::uint32_t size_plus_placeholder(const ssz_object_variable_size aut
     return ssz::size(member) + BYTES_PER_LENGTH_OFFSET;
 }
 
+namespace _detail {
+template <class T>
+consteval std::size_t fixed_part_size();
+
+/**
+ * \brief the serialized size of a fixed size object computed from its type alone.
+ */
+template <ssz_object_fixed_size T>
+consteval std::size_t static_size() {
+    if constexpr (basic_type<T>)
+        return sizeof(T);
+    else if constexpr (bitset_traits<T>::value)
+        return (bitset_traits<T>::bits + CHAR_BIT - 1) / CHAR_BIT;
+    else if constexpr (vector_traits<T>::value)
+        return vector_traits<T>::limit * static_size<typename vector_traits<T>::value_type>();
+    else
+        return fixed_part_size<T>();
+}
+
+// the size of a member in the fixed part of its container: its size or the size of its offset
+template <class T>
+consteval std::size_t placeholder_size() {
+    if constexpr (ssz_object_variable_size<T>)
+        return BYTES_PER_LENGTH_OFFSET;
+    else
+        return static_size<T>();
+}
+
+// the types of the members of a container declared with SSZ_CONT
+template <class T>
+using members_t = decltype(std::declval<const T &>().ssz_members());
+
+template <class T, std::size_t I>
+using member_t = std::remove_cvref_t<std::tuple_element_t<I, members_t<T>>>;
+
+// the position of every member, or of its offset, in the fixed part of a container whose members have the types of
+// the tuple Members, followed by the size of the fixed part
+template <class Members>
+consteval auto member_positions() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+        std::array<std::size_t, sizeof...(I) + 1> ret{};
+        std::size_t pos{};
+        ((ret[I] = pos, pos += placeholder_size<std::remove_cvref_t<std::tuple_element_t<I, Members>>>()), ...);
+        ret[sizeof...(I)] = pos;
+        return ret;
+    }(std::make_index_sequence<std::tuple_size_v<Members>>{});
+}
+
+template <class Members>
+consteval bool all_members_fixed_size() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+        return (true && ... && ssz_object_fixed_size<std::remove_cvref_t<std::tuple_element_t<I, Members>>>);
+    }(std::make_index_sequence<std::tuple_size_v<Members>>{});
+}
+
+/**
+ * \brief the size of the fixed part of a container declared with SSZ_CONT, its total size if it has fixed size.
+ */
+template <class T>
+consteval std::size_t fixed_part_size() {
+    return member_positions<members_t<T>>().back();
+}
+}  // namespace _detail
+
 constexpr std::uint32_t compute_fixed_length(const ssz_object auto &...members) {
     return (... + size_or_placeholder(members));
 }
@@ -75,22 +159,30 @@ constexpr std::uint32_t compute_total_length(const ssz_object auto &...members)
     return (... + size_plus_placeholder(members));
 }
 
-constexpr void serialize(ssz_iterator auto result, const ssz_object auto &...members) {
-    auto fsize = compute_fixed_length(members...);
+/**
+ * \brief serializes in place the members of a container, returns the end of the bytes written.
+ *
+ * The fixed part is laid out from the types alone and every variable size member reports where it ends, so each
+ * member is written in a single pass and no size is computed while writing.
+ */
+constexpr auto serialize_container(ssz_iterator auto result, const ssz_object auto &...members) {
+    constexpr auto fsize = (std::size_t{} + ... + _detail::placeholder_size<std::remove_cvref_t<decltype(members)>>());
     auto variable = result + fsize;
     auto begin = result;
     auto serialize_member = [&](const auto &member) {
         if constexpr (ssz_object_fixed_size<decltype(member)>) {
-            serialize(result, member);
-            result += ssz::size(member);
+            result = serialize(result, member);
         } else {
-            serialize(result, static_cast<std::uint32_t>(std::distance(begin, variable)));
-            serialize(variable, member);
-            result += BYTES_PER_LENGTH_OFFSET;
-            variable += ssz::size(member);
+            result = serialize(result, static_cast<std::uint32_t>(std::distance(begin, variable)));
+            variable = serialize(variable, member);
         };
     };
     (serialize_member(members), ...);
+    return variable;
+}
+
+constexpr auto serialize(ssz_iterator auto result, const ssz_object auto &...members) {
+    return serialize_container(result, members...);
 }
 
 template <class R>
@@ -103,7 +195,7 @@ constexpr auto serialize(const R &container) {
 
 template <class R>
     requires std::derived_from<R, ssz_container>
-constexpr void serialize(ssz_iterator auto result, const R &container) {
+constexpr auto serialize(ssz_iterator auto result, const R &container) {
     return container.serialize(result);
 }
 
@@ -115,16 +207,20 @@ auto deserialize(const serialized_range auto &bytes, R &r) {
     r.deserialize(bytes);
 }
 
+// deserializes the fixed size members and returns the offsets of the variable size ones, their number is known at
+// compile time so the offsets are kept on the stack
 constexpr auto deserialize_fixed_size_members(const serialized_range auto &bytes, ssz_object auto &...members) {
+    constexpr auto variable_count = (std::size_t{} + ... + ssz_object_variable_size<decltype(members)>);
     auto shifted_bytes = std::ranges::subrange(std::begin(bytes), std::end(bytes));
-    std::vector<std::uint32_t> offsets{};
+    std::array<std::uint32_t, variable_count> offsets{};
+    std::size_t idx{};
     auto deserialize_member = [&](auto &member) {
         if constexpr (ssz_object_fixed_size<decltype(member)>) {
             auto member_size = ssz::size(member);
             deserialize(shifted_bytes | std::views::take(member_size), member);
             shifted_bytes.advance(member_size);
         } else {
-            offsets.push_back(*reinterpret_cast<const std::uint32_t *>(&*std::begin(shifted_bytes)));
+            offsets[idx++] = *reinterpret_cast<const std::uint32_t *>(&*std::begin(shifted_bytes));
             shifted_bytes.advance(BYTES_PER_LENGTH_OFFSET);
         }
     };
@@ -151,12 +247,32 @@ constexpr auto deserialize_variable_size_members(const serialized_range auto &by
     (deserialize_member(members), ...);
 }
 
+namespace _detail {
+// deserializes the members of a fixed size container, each one from a fixed extent span at its constant position
+constexpr void deserialize_fixed_members(const serialized_range auto &bytes, ssz_object auto &...members) {
+    constexpr auto positions = member_positions<std::tuple<decltype(members)...>>();
+    if (std::ranges::size(bytes) < positions.back()) throw std::invalid_argument("not enough serialized bytes");
+    auto data = std::ranges::data(bytes);
+    auto tied = std::tie(members...);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        (deserialize(std::span<const std::byte, positions[I + 1] - positions[I]>{data + positions[I],
+                                                                                 positions[I + 1] - positions[I]},
+                     std::get<I>(tied)),
+         ...);
+    }(std::index_sequence_for<decltype(members)...>{});
+}
+}  // namespace _detail
+
 constexpr void deserialize_container(const serialized_range auto &bytes, ssz_object auto &...members) {
-    auto offsets = deserialize_fixed_size_members(bytes, members...);
-    if (offsets.empty()) {
-        return;
+    if constexpr ((ssz_object_fixed_size<decltype(members)> && ...)) {
+        _detail::deserialize_fixed_members(bytes, members...);
+    } else {
+        auto offsets = deserialize_fixed_size_members(bytes, members...);
+        if (offsets.empty()) {
+            return;
+        }
+        deserialize_variable_size_members(bytes, offsets, members...);
     }
-    deserialize_variable_size_members(bytes, offsets, members...);
 }
 
 #ifdef HAVE_YAML
@@ -196,15 +312,322 @@ auto hash_tree_root(const R &r, size_t cpu_count = 0) {
     return ret;
 }
 
+namespace _detail {
+// members serializing to less bytes than this are hashed on the calling thread
+constexpr std::size_t min_parallel_member_size{1 << 16};
+
+// sized ranges of basic types, such as byte lists, whose packed size is known in O(1)
+template <class R>
+concept packed_range = std::ranges::sized_range<R> && basic_type<std::ranges::range_value_t<R>>;
+
+/**
+ * \brief an estimate of the serialized size of obj, used to split the work of hashing it.
+ *
+ * It takes O(1) per member, except for lists of byte lists, such as transactions, which add up the packed sizes of
+ * their elements in O(1) each. Other variable size elements of lists count for one chunk each instead of being walked.
+ */
+template <class T>
+constexpr std::size_t hash_weight(const T &obj) {
+    if constexpr (ssz_object_fixed_size<T>) {
+        return ssz::size(obj);
+    } else if constexpr (requires { obj.ssz_members(); }) {
+        return std::apply([](const auto &...members) { return (std::size_t{} + ... + hash_weight(members)); },
+                          obj.ssz_members());
+    } else if constexpr (std::ranges::sized_range<T>) {
+        using value_type = std::ranges::range_value_t<T>;
+        auto count = static_cast<std::size_t>(std::ranges::size(obj));
+        if constexpr (std::is_same_v<value_type, bool>)
+            return count / CHAR_BIT + 1;
+        else if constexpr (ssz_object_fixed_size<value_type>)
+            return count * static_size<value_type>();
+        else if constexpr (packed_range<value_type>)
+            return std::ranges::fold_left(
+                obj | std::views::transform([](const auto &elem) { return hash_weight(elem); }), std::size_t{},
+                std::plus{});
+        else
+            return count * BYTES_PER_CHUNK;
+    } else {
+        return ssz::size(obj);
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief computes the hash tree root of a container given its members.
+ *
+ * When more than one thread is available, the members larger than min_parallel_member_size are hashed concurrently as
+ * tasks in the thread pool, each one with a share of cpu_count proportional to its estimated size. The small members
+ * are hashed on the calling thread while the large ones run. Containers without large members are hashed serially
+ * without touching the pool.
+ */
 void _container_hash(ssz_iterator auto result, size_t cpu_count, const ssz_object auto &...members) {
-    std::vector<std::byte> ret(sizeof...(members) * BYTES_PER_CHUNK);
-    auto to_hash = std::begin(ret);
-    auto htr_member = [&](const auto &member) {
-        hash_tree_root(to_hash, member, cpu_count);
-        to_hash += BYTES_PER_CHUNK;
+    std::array<std::byte, sizeof...(members) * BYTES_PER_CHUNK> ret{};
+    auto hash_serially = [&] {
+        auto to_hash = std::begin(ret);
+        auto htr_member = [&](const auto &member) {
+            hash_tree_root(to_hash, member, 1);
+            to_hash += BYTES_PER_CHUNK;
+        };
+        (htr_member(members), ...);
+        return hash_tree_root(result, ret, 1);
+    };
+    if (cpu_count == 1) return hash_serially();
+    const std::array<std::size_t, sizeof...(members)> sizes{_detail::hash_weight(members)...};
+    auto large_size = std::ranges::fold_left(sizes | std::views::filter([](auto size) {
+                                                 return size >= _detail::min_parallel_member_size;
+                                             }),
+                                             std::size_t{}, std::plus{});
+    if (large_size == 0) return hash_serially();
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    if (cpu_count < 2) return hash_serially();
+    task_group tasks{};
+    auto submit_member = [&, idx = std::size_t{}](const auto &member) mutable {
+        auto to_hash = std::begin(ret) + idx * BYTES_PER_CHUNK;
+        if (sizes[idx] >= _detail::min_parallel_member_size) {
+            auto share = std::max(std::size_t{1}, (sizes[idx] * cpu_count + large_size / 2) / large_size);
+            tasks.run([&member, to_hash, share]() { hash_tree_root(to_hash, member, share); });
+        }
+        idx++;
+    };
+    auto htr_small_member = [&, idx = std::size_t{}](const auto &member) mutable {
+        if (sizes[idx] < _detail::min_parallel_member_size)
+            hash_tree_root(std::begin(ret) + idx * BYTES_PER_CHUNK, member, 1);
+        idx++;
     };
-    (htr_member(members), ...);
-    hash_tree_root(result, ret, cpu_count);
+    (submit_member(members), ...);
+    (htr_small_member(members), ...);
+    tasks.wait();
+    hash_tree_root(result, ret, 1);
+}
+namespace _detail {
+template <class T>
+void parallel_deserialize(std::span<const std::byte> bytes, T &ret, std::size_t cpu_count);
+
+// deserializes the fixed size elements of a list or vector, split in cpu_count ranges decoded concurrently
+template <ssz_object_fixed_size T>
+void parallel_deserialize_elements(std::span<const std::byte> bytes, std::span<T> elements, std::size_t cpu_count) {
+    constexpr auto element_size = static_size<T>();
+    auto parts = std::min(cpu_count, elements.size());
+    task_group tasks{};
+    for (std::size_t part = 0; part < parts; part++) {
+        auto first = elements.size() * part / parts;
+        auto last = elements.size() * (part + 1) / parts;
+        tasks.run([bytes, elements, first, last]() {
+            for (auto i = first; i < last; i++) deserialize(bytes.subspan(i * element_size, element_size), elements[i]);
+        });
+    }
+    tasks.wait();
+}
+
+// deserializes the members of a container, the ones larger than min_parallel_member_size concurrently
+template <class T>
+void parallel_deserialize_members(std::span<const std::byte> bytes, T &ret, std::size_t cpu_count) {
+    constexpr auto member_count = std::tuple_size_v<members_t<T>>;
+    constexpr auto fixed_size = fixed_part_size<T>();
+    if (bytes.size() < fixed_size) throw std::invalid_argument("not enough serialized bytes");
+    std::array<std::size_t, member_count> begins{};
+    std::array<std::size_t, member_count> ends{};
+    // locate every member, a variable size member ends where the next one starts
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        std::size_t pos{};
+        auto previous = member_count;
+        auto locate = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            using member_type = member_t<T, J>;
+            if constexpr (ssz_object_variable_size<member_type>) {
+                std::uint32_t offset{};
+                deserialize(bytes.subspan(pos, BYTES_PER_LENGTH_OFFSET), offset);
+                auto first_variable = (previous == member_count);
+                if ((first_variable && offset != fixed_size) || (!first_variable && offset < begins[previous]) ||
+                    offset > bytes.size())
+                    throw std::invalid_argument("invalid member offset");
+                if (previous != member_count) ends[previous] = offset;
+                begins[J] = offset;
+                previous = J;
+            } else {
+                begins[J] = pos;
+                ends[J] = pos + static_size<member_type>();
+            }
+            pos += placeholder_size<member_type>();
+        };
+        (locate(std::integral_constant<std::size_t, I>{}), ...);
+        if (previous != member_count) ends[previous] = bytes.size();
+    }(std::make_index_sequence<member_count>{});
+
+    std::size_t large_size{};
+    for (std::size_t i = 0; i < member_count; i++)
+        if (ends[i] - begins[i] >= min_parallel_member_size) large_size += ends[i] - begins[i];
+    task_group tasks{};
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        auto members = ret.ssz_members();
+        auto submit_member = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            auto size = ends[J] - begins[J];
+            if (size < min_parallel_member_size) return;
+            auto share = std::max(std::size_t{1}, (size * cpu_count + large_size / 2) / large_size);
+            tasks.run([&member = std::get<J>(members), member_bytes = bytes.subspan(begins[J], size), share]() {
+                parallel_deserialize(member_bytes, member, share);
+            });
+        };
+        auto deserialize_small_member = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            auto size = ends[J] - begins[J];
+            if (size < min_parallel_member_size) deserialize(bytes.subspan(begins[J], size), std::get<J>(members));
+        };
+        (submit_member(std::integral_constant<std::size_t, I>{}), ...);
+        (deserialize_small_member(std::integral_constant<std::size_t, I>{}), ...);
+    }(std::make_index_sequence<member_count>{});
+    tasks.wait();
+}
+
+template <class T>
+void parallel_deserialize(std::span<const std::byte> bytes, T &ret, std::size_t cpu_count) {
+    if (cpu_count < 2 || bytes.size() < min_parallel_member_size) {
+        deserialize(bytes, ret);
+    } else if constexpr (requires { ret.ssz_members(); }) {
+        parallel_deserialize_members(bytes, ret, cpu_count);
+    } else if constexpr (list_traits<T>::value) {
+        using value_type = typename list_traits<T>::value_type;
+        if constexpr (std::is_same_v<T, list<value_type, list_traits<T>::limit>> &&
+                      ssz_object_fixed_size<value_type>) {
+            auto count = vector_length<value_type>(bytes);
+            ret.data().clear();
+            ret.data().resize(count);
+            parallel_deserialize_elements(bytes, std::span<value_type>{ret.data()}, cpu_count);
+        } else {
+            deserialize(bytes, ret);
+        }
+    } else if constexpr (vector_traits<T>::value && ssz_object_fixed_size<T> && std::ranges::contiguous_range<T>) {
+        if (bytes.size() != static_size<T>()) throw std::invalid_argument("wrong serialized size");
+        parallel_deserialize_elements(bytes, std::span<typename T::value_type>{ret}, cpu_count);
+    } else {
+        deserialize(bytes, ret);
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief deserializes bytes into ret using up to cpu_count threads of the pool, 0 meaning all of them.
+ *
+ * Members of containers larger than min_parallel_member_size are deserialized concurrently, each with a share of
+ * cpu_count proportional to its serialized size, and large lists and vectors of fixed size elements are split in
+ * ranges decoded concurrently. Smaller objects are deserialized as by deserialize(bytes, ret).
+ */
+template <ssz_object T>
+void deserialize_parallel(const serialized_range auto &bytes, T &ret, std::size_t cpu_count = 0) {
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    _detail::parallel_deserialize(std::span<const std::byte>{std::ranges::data(bytes), std::ranges::size(bytes)}, ret,
+                                  cpu_count);
+}
+namespace _detail {
+template <class T>
+void parallel_serialize(std::byte *out, const T &r, std::size_t size, std::size_t cpu_count);
+
+// serializes fixed size elements split in cpu_count ranges written concurrently
+template <ssz_object_fixed_size T>
+void parallel_serialize_elements(std::byte *out, std::span<const T> elements, std::size_t cpu_count) {
+    constexpr auto element_size = static_size<T>();
+    auto parts = std::min(cpu_count, elements.size());
+    task_group tasks{};
+    for (std::size_t part = 0; part < parts; part++) {
+        auto first = elements.size() * part / parts;
+        auto last = elements.size() * (part + 1) / parts;
+        tasks.run([out, elements, first, last]() {
+            serialize(out + first * element_size, elements.subspan(first, last - first));
+        });
+    }
+    tasks.wait();
+}
+
+// serializes the members of a container, the ones larger than min_parallel_member_size concurrently
+template <class T>
+void parallel_serialize_members(std::byte *out, const T &r, std::size_t cpu_count) {
+    constexpr auto member_count = std::tuple_size_v<members_t<T>>;
+    auto members = r.ssz_members();
+    std::array<std::size_t, member_count> sizes{};
+    std::array<std::size_t, member_count> positions{};
+    // lay out the members and write the offsets of the variable size ones
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        std::size_t pos{};
+        std::size_t variable_pos{fixed_part_size<T>()};
+        auto place = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            using member_type = member_t<T, J>;
+            sizes[J] = ssz::size(std::get<J>(members));
+            if constexpr (ssz_object_variable_size<member_type>) {
+                serialize(out + pos, static_cast<std::uint32_t>(variable_pos));
+                positions[J] = variable_pos;
+                variable_pos += sizes[J];
+            } else {
+                positions[J] = pos;
+            }
+            pos += placeholder_size<member_type>();
+        };
+        (place(std::integral_constant<std::size_t, I>{}), ...);
+    }(std::make_index_sequence<member_count>{});
+
+    std::size_t large_size{};
+    for (auto size : sizes)
+        if (size >= min_parallel_member_size) large_size += size;
+    task_group tasks{};
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        auto submit_member = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            if (sizes[J] < min_parallel_member_size) return;
+            auto share = std::max(std::size_t{1}, (sizes[J] * cpu_count + large_size / 2) / large_size);
+            tasks.run([&member = std::get<J>(members), member_out = out + positions[J], size = sizes[J], share]() {
+                parallel_serialize(member_out, member, size, share);
+            });
+        };
+        auto serialize_small_member = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            if (sizes[J] < min_parallel_member_size) serialize(out + positions[J], std::get<J>(members));
+        };
+        (submit_member(std::integral_constant<std::size_t, I>{}), ...);
+        (serialize_small_member(std::integral_constant<std::size_t, I>{}), ...);
+    }(std::make_index_sequence<member_count>{});
+    tasks.wait();
+}
+
+// size is the serialized size of r, computed once by the caller
+template <class T>
+void parallel_serialize(std::byte *out, const T &r, std::size_t size, std::size_t cpu_count) {
+    if (cpu_count < 2 || size < min_parallel_member_size) {
+        serialize(out, r);
+    } else if constexpr (requires { r.ssz_members(); }) {
+        parallel_serialize_members(out, r, cpu_count);
+    } else if constexpr (list_traits<T>::value) {
+        using value_type = typename list_traits<T>::value_type;
+        if constexpr (std::is_same_v<T, list<value_type, list_traits<T>::limit>> &&
+                      ssz_object_fixed_size<value_type>) {
+            parallel_serialize_elements(out, std::span<const value_type>{r.data()}, cpu_count);
+        } else {
+            serialize(out, r);
+        }
+    } else if constexpr (vector_traits<T>::value && ssz_object_fixed_size<T> && std::ranges::contiguous_range<T>) {
+        parallel_serialize_elements(out, std::span<const typename T::value_type>{r}, cpu_count);
+    } else {
+        serialize(out, r);
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief serializes r into result using up to cpu_count threads of the pool, 0 meaning all of them.
+ *
+ * The position of every member is computed first, then members of containers larger than min_parallel_member_size
+ * are written concurrently into their own range of the output, and large lists and vectors of fixed size elements are
+ * split in ranges written concurrently. result must point to ssz::size(r) contiguous zeroed bytes, the end of
+ * the bytes written is returned.
+ */
+template <ssz_object T>
+auto serialize_parallel(ssz_iterator auto result, const T &r, std::size_t cpu_count = 0) {
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    auto size = ssz::size(r);
+    _detail::parallel_serialize(&*result, r, size, cpu_count);
+    return result + size;
+}
+
+template <ssz_object T>
+std::vector<std::byte> serialize_parallel(const T &r, std::size_t cpu_count = 0) {
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    std::vector<std::byte> ret(ssz::size(r));
+    _detail::parallel_serialize(ret.data(), r, ret.size(), cpu_count);
+    return ret;
 }
 }  // namespace ssz
 
@@ -21,7 +21,15 @@
 #pragma once
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <bit>
 #include <climits>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <vector>
 #ifdef HAVE_YAML
 #include <yaml-cpp/yaml.h>
 #endif
@@ -31,32 +39,206 @@
 namespace ssz {
 const uint32_t BYTES_PER_LENGTH_OFFSET{4};
 
+namespace _detail {
+/**
+ * \brief the elements of a list written since its last hash, one bit per element.
+ *
+ * The bits are atomic words so that different elements can be marked from different threads, as they can be written.
+ */
+class dirty_elements {
+   private:
+    static constexpr std::size_t word_bits{64};
+    std::unique_ptr<std::atomic<std::uint64_t>[]> m_words{};
+    std::size_t m_word_count{};
+    std::atomic<bool> m_all{true};
+
+   public:
+    // marks the element at idx, safe to call concurrently for any elements
+    void mark_dirty(std::size_t idx) noexcept {
+        if (m_all.load(std::memory_order_relaxed)) return;
+        auto word = idx / word_bits;
+        if (word >= m_word_count) {
+            m_all.store(true, std::memory_order_relaxed);
+            return;
+        }
+        auto bit = std::uint64_t{1} << (idx % word_bits);
+        if ((m_words[word].load(std::memory_order_relaxed) & bit) == 0)
+            m_words[word].fetch_or(bit, std::memory_order_relaxed);
+    }
+    void mark_all_dirty() noexcept { m_all.store(true, std::memory_order_relaxed); }
+    bool all_dirty() const noexcept { return m_all.load(std::memory_order_relaxed); }
+
+    // makes room for count elements, requires exclusive access to the list
+    void reserve(std::size_t count) {
+        auto words = (count + word_bits - 1) / word_bits;
+        if (words <= m_word_count) return;
+        words = std::max(words, 2 * m_word_count);
+        auto marks = std::make_unique<std::atomic<std::uint64_t>[]>(words);
+        for (std::size_t i = 0; i < m_word_count; i++)
+            marks[i].store(m_words[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_words = std::move(marks);
+        m_word_count = words;
+    }
+
+    // the marked indices below count in increasing order
+    std::vector<std::size_t> dirty(std::size_t count) const {
+        std::vector<std::size_t> ret{};
+        for (std::size_t word = 0; word < m_word_count; word++) {
+            for (auto bits = m_words[word].load(std::memory_order_relaxed); bits != 0; bits &= bits - 1) {
+                auto idx = word * word_bits + static_cast<std::size_t>(std::countr_zero(bits));
+                if (idx < count) ret.push_back(idx);
+            }
+        }
+        return ret;
+    }
+    void clear() noexcept {
+        for (std::size_t word = 0; word < m_word_count; word++) m_words[word].store(0, std::memory_order_relaxed);
+        m_all.store(false, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * \brief the root cache of a list that opted in with enable(), created by the first call to get().
+ *
+ * Cache derives from dirty_elements and is only required to be complete where get() is called. The cache is created
+ * from const hashes, possibly from several threads at once. A copy keeps the setting but starts without a cache, and
+ * comparisons ignore it, so that the lists holding it can keep their defaulted operators.
+ */
+template <class Cache>
+class root_cache_ptr {
+   private:
+    mutable std::shared_ptr<dirty_elements> m_owner{};
+    mutable std::atomic<dirty_elements*> m_cache{nullptr};
+    bool m_enabled{false};
+
+    void release() noexcept {
+        m_cache.store(nullptr);
+        m_owner.reset();
+    }
+
+   public:
+    root_cache_ptr() noexcept = default;
+    root_cache_ptr(const root_cache_ptr& other) noexcept : m_enabled{other.m_enabled} {}
+    root_cache_ptr(root_cache_ptr&& other) noexcept
+        : m_owner{std::move(other.m_owner)}, m_cache{other.m_cache.exchange(nullptr)}, m_enabled{other.m_enabled} {}
+    root_cache_ptr& operator=(const root_cache_ptr& other) noexcept {
+        m_enabled = other.m_enabled;
+        if (m_enabled)
+            mark_all_dirty();
+        else
+            release();
+        return *this;
+    }
+    root_cache_ptr& operator=(root_cache_ptr&& other) noexcept {
+        m_owner = std::move(other.m_owner);
+        m_cache.store(other.m_cache.exchange(nullptr));
+        m_enabled = other.m_enabled;
+        return *this;
+    }
+
+    // requires exclusive access to the list
+    void enable() noexcept { m_enabled = true; }
+    bool enabled() const noexcept { return m_enabled; }
+
+    void mark_dirty(std::size_t idx) const noexcept {
+        if (auto cache = m_cache.load(std::memory_order_acquire)) cache->mark_dirty(idx);
+    }
+    void mark_all_dirty() const noexcept {
+        if (auto cache = m_cache.load(std::memory_order_acquire)) cache->mark_all_dirty();
+    }
+    // marks the element about to be appended at idx, requires exclusive access to the list
+    void mark_appended(std::size_t idx) {
+        if (auto cache = m_cache.load(std::memory_order_acquire)) {
+            cache->reserve(idx + 1);
+            cache->mark_dirty(idx);
+        }
+    }
+
+    // the cache, created on first use, or null if the list did not opt in
+    Cache* get() const {
+        if (!m_enabled) return nullptr;
+        auto cache = m_cache.load(std::memory_order_acquire);
+        if (cache != nullptr) return static_cast<Cache*>(cache);
+        auto created = std::make_shared<Cache>();
+        if (!m_cache.compare_exchange_strong(cache, created.get(), std::memory_order_acq_rel))
+            return static_cast<Cache*>(cache);
+        m_owner = std::move(created);
+        return static_cast<Cache*>(m_owner.get());
+    }
+
+    bool operator==(const root_cache_ptr&) const noexcept { return true; }
+    auto operator<=>(const root_cache_ptr&) const noexcept { return std::strong_ordering::equal; }
+};
+
+// defined in merkleize.hpp
+template <std::size_t N>
+class element_root_cache;
+}  // namespace _detail
+
+/**
+ * \brief an SSZ list of at most N elements of type T.
+ *
+ * Lists of composite types can keep the roots of their elements between calls to hash_tree_root after
+ * enable_root_cache(), so that only the elements written in between are rehashed. The cache costs about 64 bytes per
+ * element. Writes are tracked through the non-const accessors: operator[] and push_back mark one element, reset,
+ * data(), and the non-const iterators mark all of them. Different elements may be written from different threads. A
+ * copy keeps the setting but starts without the roots of the original, and the cache takes no part in comparisons.
+ */
 template <ssz_object T, std::size_t N>
 class list {
    private:
     std::vector<T> m_list;
+    _detail::root_cache_ptr<_detail::element_root_cache<N>> m_roots{};
 
    public:
     list(const std::vector<T> &list = {}) noexcept : m_list{list} {};
     list(std::vector<T> &&list) noexcept : m_list{std::move(list)} {};
 
-    constexpr auto begin() noexcept { return m_list.begin(); }
+    constexpr auto begin() noexcept {
+        m_roots.mark_all_dirty();
+        return m_list.begin();
+    }
     constexpr auto begin() const noexcept { return m_list.begin(); }
-    constexpr auto rbegin() noexcept { return m_list.rbegin(); }
+    constexpr auto rbegin() noexcept {
+        m_roots.mark_all_dirty();
+        return m_list.rbegin();
+    }
     constexpr auto cbegin() const noexcept { return m_list.cbegin(); }
     constexpr auto crbegin() const noexcept { return m_list.crbegin(); }
-    constexpr auto end() noexcept { return m_list.end(); }
+    constexpr auto end() noexcept {
+        m_roots.mark_all_dirty();
+        return m_list.end();
+    }
     constexpr auto end() const noexcept { return m_list.end(); }
-    constexpr auto rend() noexcept { return m_list.rend(); }
+    constexpr auto rend() noexcept {
+        m_roots.mark_all_dirty();
+        return m_list.rend();
+    }
     constexpr auto cend() const noexcept { return m_list.cend(); }
     constexpr auto crend() const noexcept { return m_list.crend(); }
     constexpr auto size() const noexcept { return m_list.size(); }
     static constexpr auto limit() noexcept { return N; }
-    constexpr auto reset(std::vector<T> &vec) noexcept { m_list = std::move(vec); }
-    constexpr void push_back(T &&value) { m_list.push_back(std::move(value)); }
-    constexpr void push_back(const T &value) { m_list.push_back(value); }
-    auto &data() noexcept { return m_list; }
+    constexpr auto reset(std::vector<T> &vec) noexcept {
+        m_list = std::move(vec);
+        m_roots.mark_all_dirty();
+    }
+    constexpr void push_back(T &&value) {
+        m_roots.mark_appended(m_list.size());
+        m_list.push_back(std::move(value));
+    }
+    constexpr void push_back(const T &value) {
+        m_roots.mark_appended(m_list.size());
+        m_list.push_back(value);
+    }
+    auto &data() noexcept {
+        m_roots.mark_all_dirty();
+        return m_list;
+    }
     constexpr auto &data() const noexcept { return m_list; }
+    // keeps the element roots between hashes from the next hash on, requires exclusive access to the list
+    void enable_root_cache() noexcept { m_roots.enable(); }
+    // the element roots kept between hashes, or null without enable_root_cache()
+    auto root_cache() const { return m_roots.get(); }
 
     struct variable_size : std::true_type {};
     using value_type = typename std::vector<T>::value_type;
@@ -72,7 +254,10 @@ class list {
     using reverse_iterator = typename std::vector<T>::reverse_iterator;
     using const_reverse_iterator = typename std::vector<T>::const_reverse_iterator;
 
-    constexpr auto &operator[](size_type pos) { return m_list[pos]; }
+    constexpr auto &operator[](size_type pos) {
+        m_roots.mark_dirty(pos);
+        return m_list[pos];
+    }
     constexpr auto &operator[](size_type pos) const { return m_list[pos]; }
 
     constexpr auto operator<=>(const list<T, N> &rhs) const noexcept = default;
@@ -120,6 +305,61 @@ template <std::size_t N>
 constexpr size_t size(const ssz::list<bool, N> &r) noexcept {
   return r.size() / CHAR_BIT + 1;
 }
+
+namespace _detail {
+template <class T>
+consteval bool detect_packed_layout();
+}
+/**
+ * \brief true when the memory representation of T on this host is its SSZ serialization.
+ *
+ * Contiguous vectors and lists of such types are serialized and deserialized with a single copy of their bytes. It
+ * holds for basic types other than bool, arrays of packed types, and containers declared with SSZ_CONT whose members
+ * are all packed and laid out in the order given to SSZ_CONT without padding, on little endian hosts. It may be
+ * specialized to false to opt a type out, or to true for types whose layout the detection cannot see through.
+ */
+template <class T>
+constexpr bool packed_layout = _detail::detect_packed_layout<T>();
+
+namespace _detail {
+// the members of T are all packed, their sizes add up to sizeof(T), and their addresses increase in SSZ_CONT order
+template <class T>
+consteval bool packed_members() {
+  using members_type = decltype(std::declval<T &>().ssz_members());
+  return []<std::size_t... I>(std::index_sequence<I...>) {
+    if constexpr (!(packed_layout<std::remove_cvref_t<std::tuple_element_t<I, members_type>>> && ...) ||
+                  (sizeof(std::remove_cvref_t<std::tuple_element_t<I, members_type>>) + ... + 0) != sizeof(T)) {
+      return false;
+    } else {
+      T t{};
+      auto members = t.ssz_members();
+      const void *addresses[] = {&std::get<I>(members)...};
+      return std::ranges::is_sorted(addresses, std::less<const void *>{});
+    }
+  }(std::make_index_sequence<std::tuple_size_v<members_type>>{});
+}
+
+template <class T>
+consteval bool detect_packed_layout() {
+  if constexpr (std::endian::native != std::endian::little || !std::is_trivially_copyable_v<T> ||
+                std::is_same_v<T, bool>) {
+    return false;
+  } else if constexpr (basic_type<T>) {
+    return true;
+  } else if constexpr (requires { typename std::tuple_size<T>::type; typename T::value_type; }) {
+    // std::array
+    using value_type = typename T::value_type;
+    return packed_layout<value_type> && sizeof(T) == std::tuple_size_v<T> * sizeof(value_type);
+  } else if constexpr (requires { T::ssz_fixed_members; }) {
+    if constexpr (!T::ssz_fixed_members || T::ssz_fixed_part_size != sizeof(T))
+      return false;
+    else
+      return packed_members<T>();
+  } else {
+    return false;
+  }
+}
+}  // namespace _detail
 // Serialization
 namespace {
 // contiguous lists of basic types (use casting and one memory copy)
@@ -146,45 +386,48 @@ constexpr void _serialize_big_endian_basic_list(auto result, const auto &r) {
 // serialize in place contiguous lists of basic types, eg std::vector<uint8_t>
 // or std::array<uint8_t, N>
 template <std::ranges::sized_range R>
-constexpr void serialize(std::weakly_incrementable auto result, const R &r)
+constexpr auto serialize(std::weakly_incrementable auto result, const R &r)
   requires std::is_same_v<decltype(*result), std::byte &> &&
            basic_type<std::ranges::range_value_t<R>> &&
            std::ranges::contiguous_range<R>
 {
   if (std::ranges::size(r) == 0) {
-      return;
+      return result;
   }
   if constexpr (std::endian::native == std::endian::little) {
     _serialize_little_endian_basic_list(result, r);
   } else {
     _serialize_big_endian_basic_list(result, r);
   }
+  return result + std::ranges::size(r) * sizeof(std::ranges::range_value_t<R>);
 }
-// serialize in place lists of variable size objects
+// serialize in place lists of variable size objects, each element is written once without computing its size
 template <std::ranges::sized_range R>
-constexpr void serialize(std::weakly_incrementable auto result, const R &r)
+constexpr auto serialize(std::weakly_incrementable auto result, const R &r)
   requires(std::is_same_v<decltype(*result), std::byte &> &&
            ssz_object_variable_size<std::ranges::range_value_t<R>>)
 {
   auto data = result + std::ranges::size(r) * BYTES_PER_LENGTH_OFFSET;
   for (const auto &[idx, v] : std::views::enumerate(r)) {
     serialize(result + idx * BYTES_PER_LENGTH_OFFSET, static_cast<std::uint32_t>(std::distance(result, data)));
-    serialize(data, v);
-    std::advance(data, size(v));
+    data = serialize(data, v);
   };
-  result = data;
+  return data;
 }
 // serialize in place lists of fixed size objects (no offsets)
 template <std::ranges::sized_range R>
-constexpr void serialize(std::weakly_incrementable auto result, const R &r)
+constexpr auto serialize(std::weakly_incrementable auto result, const R &r)
   requires(std::is_same_v<decltype(*result), std::byte &> &&
            ssz_object_fixed_size<std::ranges::range_value_t<R>> &&
            !basic_type<std::ranges::range_value_t<R>>)
 {
-  std::ranges::for_each(r, [&](const auto &v) {
-      serialize(result, v);
-      result += ssz::size(v);
-  });
+  if constexpr (packed_layout<std::ranges::range_value_t<R>> && std::ranges::contiguous_range<R>) {
+    auto data = static_cast<const std::byte *>(static_cast<const void *>(std::ranges::data(r)));
+    return std::copy_n(data, std::ranges::size(r) * sizeof(std::ranges::range_value_t<R>), result);
+  } else {
+    std::ranges::for_each(r, [&](const auto &v) { result = serialize(result, v); });
+    return result;
+  }
 }
 // serialize lists of fixed sized objects
 constexpr auto serialize(const std::ranges::sized_range auto &r)
@@ -220,26 +463,27 @@ constexpr auto eight_bits_to_byte = [](const auto &chunk) {
     return (b << 1) | std::byte{i};
   });
 };
-constexpr void _serialize_bitvector(std::weakly_incrementable auto result,
+constexpr auto _serialize_bitvector(std::weakly_incrementable auto result,
                                     const std::ranges::sized_range auto &r) {
-  std::ranges::transform(r | std::views::chunk(CHAR_BIT), result,
-                         eight_bits_to_byte);
+  return std::ranges::transform(r | std::views::chunk(CHAR_BIT), result,
+                                eight_bits_to_byte).out;
 }
 }
 // serialize in place bitvectors modeled by std::vector<bool>
-constexpr void serialize(std::weakly_incrementable auto result,
+constexpr auto serialize(std::weakly_incrementable auto result,
                          const std::vector<bool> &r)
   requires std::is_same_v<decltype(*result), std::byte &>
 {
-  _serialize_bitvector(result, r);
+  return _serialize_bitvector(result, r);
 }
 // serialize bitlist modeled by ssz::list<bool>
 template <std::size_t N>
-constexpr void serialize(std::weakly_incrementable auto result, const ssz::list<bool, N> &r)
+constexpr auto serialize(std::weakly_incrementable auto result, const ssz::list<bool, N> &r)
     requires std::is_same_v<decltype(*result), std::byte &>
 {
   _serialize_bitvector(result, r);
   *(result + r.size() / CHAR_BIT) |= std::byte{1} << (r.size() % CHAR_BIT);
+  return result + r.size() / CHAR_BIT + 1;
 }
 
 // serialize bitlist modeled by std::vector<bool>
@@ -259,12 +503,13 @@ constexpr auto serialize(const ssz::list<bool, N> &r) {
 
 // serialize in place a bitvector modeled by a bitset
 template <std::weakly_incrementable R, std::size_t N>
-constexpr void serialize(R result, const std::bitset<N> &r)
+constexpr auto serialize(R result, const std::bitset<N> &r)
   requires std::is_same_v<decltype(*result), std::byte &>
 {
   for (std::size_t i = 0; i < N; i++) {
     result[i / CHAR_BIT] |= std::byte{r[i]} << (i % CHAR_BIT);
   }
+  return result + (N + CHAR_BIT - 1) / CHAR_BIT;
 }
 
 // serialize a bitvector modeled by a bitset
@@ -323,10 +568,16 @@ template <typename T>
     requires(!basic_type<T>)
 constexpr void __deserialize_chunked(auto _ret, const auto &bytes) {
   T vac{};  // TODO GCC 13.1 dies if we use size(T{})
+  // constant for containers declared with SSZ_CONT, elements are read at a fixed stride
   auto chunk_size = ssz::size(vac);
-  for (const auto &chunk : bytes | std::views::chunk(chunk_size)) {
-    deserialize(chunk, *_ret);
-    _ret++;
+  auto data = std::ranges::data(bytes);
+  auto count = std::ranges::size(bytes) / chunk_size;
+  if constexpr (packed_layout<T> && std::contiguous_iterator<decltype(_ret)>) {
+    // the serialized elements are the memory representation of the whole vector
+    std::copy_n(data, count * chunk_size, static_cast<std::byte *>(static_cast<void *>(std::to_address(_ret))));
+  } else {
+    for (std::size_t i = 0; i < count; i++, _ret++)
+      deserialize(std::span<const std::byte>{data + i * chunk_size, chunk_size}, *_ret);
   }
 }
 
@@ -419,6 +670,45 @@ auto deserialize(const serialized_range auto &bytes, ssz::list<bool, N> &ret) {
   if (std::ranges::size(bytes) * CHAR_BIT > N) throw std::out_of_range("byte slice larger than list limit");
   deserialize(bytes, ret.data());
 }
+
+namespace _detail {
+// compile time description of the types modeling SSZ lists and vectors, bitlists and bitvectors are described apart
+template <class T>
+struct list_traits : std::false_type {};
+
+template <ssz_object T, std::size_t N>
+  requires(!std::is_same_v<T, bool>)
+struct list_traits<list<T, N>> : std::true_type {
+  using value_type = T;
+  static constexpr std::size_t limit{N};
+};
+
+template <class T>
+struct bitlist_traits : std::false_type {};
+
+template <std::size_t N>
+struct bitlist_traits<list<bool, N>> : std::true_type {
+  static constexpr std::size_t limit{N};
+};
+
+template <class T>
+struct bitset_traits : std::false_type {};
+
+template <std::size_t N>
+struct bitset_traits<std::bitset<N>> : std::true_type {
+  static constexpr std::size_t bits{N};
+};
+
+template <class T>
+struct vector_traits : std::false_type {};
+
+template <ssz_object T, std::size_t N>
+  requires(!std::is_same_v<T, bool>)
+struct vector_traits<std::array<T, N>> : std::true_type {
+  using value_type = T;
+  static constexpr std::size_t limit{N};
+};
+} // namespace _detail
 } // namespace ssz
 
 #ifdef HAVE_YAML
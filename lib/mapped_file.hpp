@@ -0,0 +1,131 @@
+/*  mapped_file.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <system_error>
+#include <utility>
+
+#include "concepts.hpp"
+#include "container.hpp"
+
+namespace ssz {
+/**
+ * \brief a read only memory mapping of a whole file, usable as a serialized_range.
+ *
+ * With prefault the whole file is read and mapped when mapping it (MAP_POPULATE, or a read ahead request where it is
+ * not available) so that deserializing does not stop on page faults. Otherwise the kernel is told how the mapping
+ * will be accessed. Objects and views built from the mapping never copy the file
+ * into an intermediate buffer, views must not outlive the mapping.
+ */
+class mapped_file {
+   public:
+    enum class access { sequential, random };
+
+   private:
+    std::byte* m_data{nullptr};
+    std::size_t m_size{};
+
+    // error is the errno of the failed call, saved before any cleanup can overwrite it
+    [[noreturn]] static void fail(const char* what, const std::filesystem::path& path, int error) {
+        throw std::filesystem::filesystem_error(what, path, std::error_code(error, std::generic_category()));
+    }
+
+   public:
+    explicit mapped_file(const std::filesystem::path& path, access pattern = access::sequential,
+                         bool prefault = true) {
+        auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) fail("could not open file", path, errno);
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            auto error = errno;
+            ::close(fd);
+            fail("could not stat file", path, error);
+        }
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size == 0) {
+            ::close(fd);
+            return;
+        }
+        int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+        if (prefault) flags |= MAP_POPULATE;
+#endif
+        auto addr = ::mmap(nullptr, m_size, PROT_READ, flags, fd, 0);
+        auto error = errno;
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (addr == MAP_FAILED) fail("could not map file", path, error);
+        m_data = static_cast<std::byte*>(addr);
+        // a populated mapping is already resident, advice would have no effect on it
+#ifdef MAP_POPULATE
+        if (prefault) return;
+#else
+        if (prefault) {
+            ::madvise(addr, m_size, MADV_WILLNEED);
+            return;
+        }
+#endif
+        ::madvise(addr, m_size, pattern == access::sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept
+        : m_data{std::exchange(other.m_data, nullptr)}, m_size{std::exchange(other.m_size, 0)} {}
+    mapped_file& operator=(mapped_file&& other) noexcept {
+        std::swap(m_data, other.m_data);
+        std::swap(m_size, other.m_size);
+        return *this;
+    }
+    ~mapped_file() {
+        if (m_data) ::munmap(m_data, m_size);
+    }
+
+    const std::byte* data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+    const std::byte* begin() const noexcept { return m_data; }
+    const std::byte* end() const noexcept { return m_data + m_size; }
+    std::span<const std::byte> bytes() const noexcept { return {m_data, m_size}; }
+};
+
+/**
+ * \brief deserializes the object of type T stored in the file at path, reading it straight from a mapping of the file.
+ *
+ * Uses up to cpu_count threads, 0 meaning all of them.
+ */
+template <ssz_object T>
+std::unique_ptr<T> deserialize_file(const std::filesystem::path& path, std::size_t cpu_count = 0) {
+    mapped_file file{path};
+    auto ret = std::make_unique<T>();
+    deserialize_parallel(file.bytes(), *ret, cpu_count);
+    return ret;
+}
+}  // namespace ssz
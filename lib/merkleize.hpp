@@ -22,14 +22,25 @@
 
 #include <hashtree.h>
 #include <algorithm>  //copy
+#include <atomic>
+#include <bit>
+#include <condition_variable>
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
 #include <type_traits>
-#include <future>
+#include <vector>
 
 #include "basic_types.hpp"
 #include "lists.hpp"
 #include "math.hpp"
 #include "beaconchain.hpp"
+#include "scratch.hpp"
+#include "thread_pool.hpp"
 
 namespace ssz {
 constexpr std::size_t BYTES_PER_CHUNK{32};
@@ -194,6 +205,21 @@ auto sparse_hash_tree(const ssz_basic_type_vector auto& chunks, std::size_t limi
     return sparse_hash_tree(reinterpret_cast<const std::byte*>(&*std::begin(chunks)), ssz::size(chunks), limit);
 }
 
+namespace _detail {
+// writes the root of sparse_hash_tree(chunks, byte_length, limit), the tree is built in scratch memory
+void merkleize_chunks(ssz_iterator auto result, const std::byte* chunks, std::size_t byte_length, std::size_t limit) {
+    auto chunk_count = (byte_length + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK;
+    auto depth = (limit == 0) ? helpers::log2ceil(chunk_count) : helpers::log2ceil(limit);
+    if (chunk_count == 0) {
+        std::ranges::copy(zero_hash_array[depth], result);
+        return;
+    }
+    scratch_buffer hash_tree{compute_hashtree_size(chunk_count, depth)};
+    sparse_hash_tree(hash_tree.begin(), chunks, byte_length, depth);
+    std::copy_n(hash_tree.end() - BYTES_PER_CHUNK, BYTES_PER_CHUNK, result);
+}
+}  // namespace _detail
+
 // helper to mix in length in place
 auto mix_in_length(ssz_iterator auto output, const ssz_iterator auto& hash, std::uint64_t length) {
     chunk_t serialized_length{};
@@ -211,8 +237,7 @@ auto hash_tree_root(ssz::basic_type auto n, size_t = 0) {
 
 // hash_tree_root of vectors of basic objects, no copy on little endian systems
 void _htr_little_endian_basic_list(auto result, const auto& r, size_t limit = 0) {
-    auto hash_tree = sparse_hash_tree(r, limit);
-    std::ranges::copy(std::ranges::subrange(std::end(hash_tree) - BYTES_PER_CHUNK, std::end(hash_tree)), result);
+    _detail::merkleize_chunks(result, reinterpret_cast<const std::byte*>(std::ranges::data(r)), ssz::size(r), limit);
 }
 
 void _htr_big_endian_basic_list(auto result, const auto& r, size_t limit = 0) {
@@ -222,7 +247,7 @@ void _htr_big_endian_basic_list(auto result, const auto& r, size_t limit = 0) {
 template <ssz_iterator I, ssz_basic_type_vector R>
 void hash_tree_root(I result, const R& r, size_t cpu_count = 0, size_t limit = 0) {
     auto rsize = std::ranges::size(r);
-    if (cpu_count == 0) cpu_count = std::thread::hardware_concurrency();
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
     if (cpu_count < 2 || rsize < 4 * BYTES_PER_CHUNK) {
         if constexpr (std::endian::native == std::endian::little) {
             return _htr_little_endian_basic_list(result, r, limit);
@@ -236,12 +261,13 @@ void hash_tree_root(I result, const R& r, size_t cpu_count = 0, size_t limit = 0
     auto chunk_size = (half_size * sizeof(std::ranges::range_value_t<R>) + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK;
     auto first = std::ranges::subrange(std::begin(r), std::begin(r) + half_size);
     auto last = std::ranges::subrange(std::begin(r) + half_size, std::end(r));
-    std::vector<std::byte> two_blocks(2 * BYTES_PER_CHUNK);  // has to be on the heap
-    auto future = std::async(std::launch::async, [&]() {
-        hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, cpu_count / 2, chunk_size);
-    });
-    hash_tree_root(std::begin(two_blocks), first, cpu_count / 2, chunk_size);
-    future.get();
+    _detail::scratch_buffer two_blocks{2 * BYTES_PER_CHUNK};
+    // odd core counts round up, the extra task is balanced by work stealing
+    auto half_cpus = (cpu_count + 1) / 2;
+    task_group tasks{};
+    tasks.run([&]() { hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, half_cpus, chunk_size); });
+    hash_tree_root(std::begin(two_blocks), first, half_cpus, chunk_size);
+    tasks.wait();
     hash(result, two_blocks, 1);
     for (auto i = helpers::log2ceil(chunk_size) + 1; i < helpers::log2ceil(limit); i++) {
         hash_2_chunks(result, result, zero_hash_array[i]);
@@ -250,58 +276,484 @@ void hash_tree_root(I result, const R& r, size_t cpu_count = 0, size_t limit = 0
 
 // hash_tree_root of array/list of roots, avoid an extra copy and allocation
 auto _htr_array_of_array_little_endian(auto result, const auto& r, size_t limit = 0) {
-    auto hash_tree = sparse_hash_tree(reinterpret_cast<const std::byte*>(&*std::begin(r)),
-                                      std::ranges::size(r) * BYTES_PER_CHUNK, limit);
-    std::ranges::copy_n(std::end(hash_tree) - BYTES_PER_CHUNK, BYTES_PER_CHUNK, result);
+    _detail::merkleize_chunks(result, reinterpret_cast<const std::byte*>(std::ranges::data(r)),
+                              std::ranges::size(r) * BYTES_PER_CHUNK, limit);
 }
 
 template <std::ranges::sized_range R>
     requires std::is_same_v<Root, std::remove_cvref_t<std::ranges::range_value_t<R>>>
 void hash_tree_root(ssz_iterator auto result, const R& r, size_t cpu_count = 0, size_t limit = 0) {
     auto rsize = std::ranges::size(r);
-    if (cpu_count == 0) cpu_count = std::thread::hardware_concurrency();
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
     if (cpu_count < 2 || rsize < 4) {
         return _htr_array_of_array_little_endian(result, r, limit);
     }
     auto half_size = std::bit_ceil(rsize) / 2;
     auto first = std::ranges::subrange(std::begin(r), std::begin(r) + half_size);
     auto last = std::ranges::subrange(std::begin(r) + half_size, std::end(r));
-    std::vector<std::byte> two_blocks(2 * BYTES_PER_CHUNK);  // has to be on the heap
-    auto future = std::async(std::launch::async, [&]() {
-        hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, cpu_count / 2, half_size);
-    });
-    hash_tree_root(std::begin(two_blocks), first, cpu_count / 2, half_size);
-    future.get();
+    _detail::scratch_buffer two_blocks{2 * BYTES_PER_CHUNK};
+    // odd core counts round up, the extra task is balanced by work stealing
+    auto half_cpus = (cpu_count + 1) / 2;
+    task_group tasks{};
+    tasks.run([&]() { hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, half_cpus, half_size); });
+    hash_tree_root(std::begin(two_blocks), first, half_cpus, half_size);
+    tasks.wait();
     hash(result, two_blocks, 1);
     for (auto i = helpers::log2ceil(half_size) + 1; i < helpers::log2ceil(limit); i++) {
         hash_2_chunks(result, result, zero_hash_array[i]);
     }
 }
 
+namespace _detail {
+// number of chunks packed by basic objects and fixed size vectors of basic objects, 0 for other types
+template <class T>
+constexpr std::size_t packed_chunk_count{0};
+template <basic_type T>
+constexpr std::size_t packed_chunk_count<T>{1};
+template <basic_type T, std::size_t N>
+    requires(!std::is_same_v<T, bool>)
+constexpr std::size_t packed_chunk_count<std::array<T, N>>{(N * sizeof(T) + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK};
+template <std::size_t N>
+constexpr std::size_t packed_chunk_count<std::bitset<N>>{(N + CHAR_BIT * BYTES_PER_CHUNK - 1) /
+                                                         (CHAR_BIT * BYTES_PER_CHUNK)};
+
+// number of elements of a list of containers whose subtrees are hashed together
+constexpr std::size_t batch_hash_size{1 << 16};
+
+/**
+ * \brief merkleizes count consecutive subtrees of width chunks each, width being a power of two.
+ *
+ * Every layer of all the subtrees is hashed with a single call to hash. scratch has to hold count * width / 2 chunks.
+ * Returns a pointer to the count consecutive roots, which live either in chunks or in scratch.
+ */
+inline std::byte* merkleize_batch(std::byte* chunks, std::byte* scratch, std::size_t count, std::size_t width) {
+    for (; width > 1; width /= 2) {
+        hash(scratch, chunks, count * width / 2);
+        std::swap(chunks, scratch);
+    }
+    return chunks;
+}
+
+/**
+ * \brief writes the hash tree roots of the count objects of type T returned by get(0), ..., get(count - 1). The i-th
+ * root is written at out + i * stride.
+ *
+ * The members of fixed size containers and the elements of fixed size vectors are laid out column by column as the
+ * leaves of count subtrees which are then merkleized together, so that each layer takes a single call to hash
+ * regardless of the number of objects.
+ */
+template <class T>
+void batch_hash_tree_roots(std::byte* out, std::size_t stride, std::size_t count, const auto& get) {
+    auto merkleize_and_scatter = [&](scratch_buffer& leaves, std::size_t width) {
+        scratch_buffer scratch{leaves.size() / 2};
+        auto roots = merkleize_batch(leaves.data(), scratch.data(), count, width);
+        for (std::size_t i = 0; i < count; i++)
+            std::copy_n(roots + i * BYTES_PER_CHUNK, BYTES_PER_CHUNK, out + i * stride);
+    };
+    if constexpr (packed_chunk_count<T> == 1) {
+        for (std::size_t i = 0; i < count; i++) {
+            std::fill_n(out + i * stride, BYTES_PER_CHUNK, std::byte{});
+            serialize(out + i * stride, get(i));
+        }
+    } else if constexpr (packed_chunk_count<T> > 1) {
+        constexpr auto width = std::bit_ceil(packed_chunk_count<T>);
+        scratch_buffer leaves{count * width * BYTES_PER_CHUNK};
+        for (std::size_t i = 0; i < count; i++) serialize(leaves.data() + i * width * BYTES_PER_CHUNK, get(i));
+        merkleize_and_scatter(leaves, width);
+    } else if constexpr (ssz_fixed_size_container<T>) {
+        using members_t = decltype(std::declval<const T&>().ssz_members());
+        constexpr auto member_count = std::tuple_size_v<members_t>;
+        constexpr auto width = std::bit_ceil(member_count);
+        scratch_buffer leaves{count * width * BYTES_PER_CHUNK};
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (batch_hash_tree_roots<std::remove_cvref_t<std::tuple_element_t<I, members_t>>>(
+                 leaves.data() + I * BYTES_PER_CHUNK, width * BYTES_PER_CHUNK, count,
+                 [&](std::size_t i) -> decltype(auto) { return std::get<I>(get(i).ssz_members()); }),
+             ...);
+        }(std::make_index_sequence<member_count>{});
+        merkleize_and_scatter(leaves, width);
+    } else if constexpr (vector_traits<T>::value && ssz_object_fixed_size<T>) {
+        constexpr auto length = std::tuple_size_v<T>;
+        constexpr auto width = std::bit_ceil(length);
+        scratch_buffer leaves{count * width * BYTES_PER_CHUNK};
+        for (std::size_t j = 0; j < length; j++)
+            batch_hash_tree_roots<typename T::value_type>(leaves.data() + j * BYTES_PER_CHUNK,
+                                                          width * BYTES_PER_CHUNK, count,
+                                                          [&](std::size_t i) -> decltype(auto) { return get(i)[j]; });
+        merkleize_and_scatter(leaves, width);
+    } else {
+        for (std::size_t i = 0; i < count; i++) hash_tree_root(out + i * stride, get(i), 1);
+    }
+}
+
+// writes consecutively the hash tree roots of the elements of r, in batches of batch_hash_size elements
+template <std::ranges::random_access_range R>
+void hash_element_roots(std::byte* out, const R& r) {
+    auto first = std::ranges::begin(r);
+    auto rsize = static_cast<std::size_t>(std::ranges::size(r));
+    for (std::size_t done = 0; done < rsize; done += batch_hash_size) {
+        batch_hash_tree_roots<std::ranges::range_value_t<R>>(
+            out + done * BYTES_PER_CHUNK, BYTES_PER_CHUNK, std::min(batch_hash_size, rsize - done),
+            [&](std::size_t i) -> decltype(auto) { return first[done + i]; });
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief a Merkle tree that keeps all its internal layers and rehashes only the paths of the leaves that changed.
+ *
+ * Only the occupied part of each layer is stored, the missing right siblings are taken from zero_hash_array. Leaves
+ * are written through leaves() and have to be reported with mark_dirty() before the next call to root().
+ */
+class merkle_tree {
+   private:
+    std::size_t m_depth;
+    std::vector<std::vector<chunk_t>> m_layers;
+    std::vector<std::size_t> m_dirty{};
+    bool m_all_dirty{true};
+
+    // hashes the parents [first, last) of layer height + 1 from its children in layer height
+    void hash_parents(std::size_t height, std::size_t first, std::size_t last) {
+        const auto& children = m_layers[height];
+        auto& parents = m_layers[height + 1];
+        auto full = std::min(last, children.size() / 2);
+        if (full > first) {
+            hash(reinterpret_cast<std::byte*>(parents.data() + first),
+                 reinterpret_cast<const std::byte*>(children.data() + 2 * first), full - first);
+        }
+        if (last > full) hash_2_chunks(std::begin(parents[full]), children.back(), zero_hash_array[height]);
+    }
+
+   public:
+    explicit merkle_tree(std::size_t depth = 0) : m_depth{depth}, m_layers(depth + 1) {}
+
+    constexpr auto depth() const noexcept { return m_depth; }
+    auto size() const noexcept { return m_layers[0].size(); }
+    std::span<chunk_t> leaves() noexcept { return m_layers[0]; }
+    std::span<const chunk_t> leaves() const noexcept { return m_layers[0]; }
+
+    /**
+     * \brief changes the number of leaves.
+     *
+     * New leaves are zero initialized and marked dirty, if the tree shrinks the new last leaf is marked dirty since
+     * its sibling path now pads with zero hashes.
+     */
+    void resize(std::size_t count) {
+        auto old_count = size();
+        auto layer_size = count;
+        for (auto& layer : m_layers) {
+            layer.resize(layer_size);
+            layer_size = (layer_size + 1) / 2;
+        }
+        if (count < old_count && count > 0) mark_dirty(count - 1);
+        for (auto i = old_count; i < count && !m_all_dirty; i++) mark_dirty(i);
+    }
+
+    /**
+     * \brief the node at the given height (0 for the leaves) and index, padded with zero hashes.
+     *
+     * Internal nodes are only up to date after a call to root().
+     */
+    const chunk_t& node(std::size_t height, std::size_t index) const {
+        const auto& layer = m_layers[height];
+        return index < layer.size() ? layer[index] : zero_hash_array[height];
+    }
+
+    void mark_dirty(std::size_t leaf) {
+        if (m_all_dirty) return;
+        if (m_dirty.size() >= size()) {
+            mark_all_dirty();
+            return;
+        }
+        m_dirty.push_back(leaf);
+    }
+
+    void mark_all_dirty() noexcept {
+        m_all_dirty = true;
+        m_dirty.clear();
+    }
+
+    /**
+     * \brief returns the root of the tree rehashing only the paths from the dirty leaves.
+     *
+     * Each layer is hashed with one call to the hasher per run of consecutive dirty nodes, when more than half of a
+     * layer is dirty the whole layer is hashed at once.
+     */
+    chunk_t root() {
+        if (size() == 0) {
+            m_dirty.clear();
+            m_all_dirty = false;
+            return zero_hash_array[m_depth];
+        }
+        if (!m_all_dirty) {
+            std::ranges::sort(m_dirty);
+            auto [first, last] = std::ranges::unique(m_dirty);
+            m_dirty.erase(first, last);
+        }
+        for (std::size_t height = 0; height < m_depth; height++) {
+            auto parent_count = m_layers[height + 1].size();
+            if (!m_all_dirty) {
+                std::ranges::for_each(m_dirty, [](auto& idx) { idx /= 2; });
+                auto [first, last] = std::ranges::unique(m_dirty);
+                m_dirty.erase(first, last);
+                if (2 * m_dirty.size() > parent_count) mark_all_dirty();
+            }
+            if (m_all_dirty) {
+                hash_parents(height, 0, parent_count);
+                continue;
+            }
+            for (auto run = std::begin(m_dirty); run != std::end(m_dirty);) {
+                auto run_end = std::adjacent_find(run, std::end(m_dirty), [](auto a, auto b) { return b != a + 1; });
+                if (run_end != std::end(m_dirty)) run_end++;
+                hash_parents(height, *run, *std::prev(run_end) + 1);
+                run = run_end;
+            }
+        }
+        m_dirty.clear();
+        m_all_dirty = false;
+        return m_layers[m_depth][0];
+    }
+};
+
+namespace _detail {
+/**
+ * \brief marks a cache of roots as being updated, so that a single thread at a time updates it.
+ *
+ * It is a Lockable whose mutex is only held to flip the flag, never while the cache is hashed: a thread waiting on a
+ * task_group runs other queued tasks, which may hash the same object again. Hashes take it with try_lock() and, when
+ * the cache is being updated by another thread or further up their own stack, compute the root without the cache.
+ * lock() waits for the update to finish, it is only meant for callers outside of hashing tasks.
+ */
+class update_flag {
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_updating{false};
+
+   public:
+    bool try_lock() {
+        std::lock_guard lock{m_mutex};
+        return !std::exchange(m_updating, true);
+    }
+    void lock() {
+        std::unique_lock lock{m_mutex};
+        m_cv.wait(lock, [this] { return !m_updating; });
+        m_updating = true;
+    }
+    void unlock() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_updating = false;
+        }
+        m_cv.notify_all();
+    }
+};
+
+/**
+ * \brief storage and dirty tracking shared by cached_list and cached_vector.
+ *
+ * Basic types are packed into the leaves, composite types contribute their hash_tree_root as a leaf.
+ */
+template <ssz_object T, std::size_t N>
+class cached_leaves {
+   private:
+    mutable merkle_tree m_tree;
+    mutable std::vector<std::size_t> m_dirty{};
+    mutable bool m_all_dirty{true};
+
+   public:
+    static constexpr std::size_t per_leaf = basic_type<T> ? BYTES_PER_CHUNK / sizeof(T) : 1;
+    static constexpr std::size_t leaf_limit = (N + per_leaf - 1) / per_leaf;
+
+    cached_leaves() : m_tree{helpers::log2ceil(leaf_limit)} {}
+
+    void mark_dirty(std::size_t idx) const {
+        if (m_all_dirty) return;
+        // past a batch or the size of the tree, rehashing everything is cheaper than tracking more indices
+        if (m_dirty.size() >= std::min(N, std::max(batch_hash_size, m_tree.size() * per_leaf))) {
+            mark_all_dirty();
+            return;
+        }
+        m_dirty.push_back(idx);
+    }
+    void mark_all_dirty() const noexcept {
+        m_all_dirty = true;
+        m_dirty.clear();
+    }
+
+    /**
+     * \brief the root of the tree of elements, rehashing only the leaves marked dirty since the last call.
+     *
+     * When every leaf is dirty the roots of composite elements are computed in batches on up to cpu_count threads.
+     */
+    chunk_t root(std::span<const T> elements, std::size_t cpu_count = 1) const {
+        auto leaf_count = (elements.size() + per_leaf - 1) / per_leaf;
+        auto write_leaf = [&](std::size_t leaf) {
+            auto& chunk = m_tree.leaves()[leaf];
+            if constexpr (basic_type<T>) {
+                chunk = chunk_t{};
+                auto first = leaf * per_leaf;
+                serialize(std::begin(chunk), elements.subspan(first, std::min(per_leaf, elements.size() - first)));
+            } else {
+                hash_tree_root(std::begin(chunk), elements[leaf], 1);
+            }
+        };
+        if (m_tree.size() != leaf_count) m_tree.resize(leaf_count);
+        if (m_all_dirty) {
+            if constexpr (basic_type<T>) {
+                for (std::size_t leaf = 0; leaf < leaf_count; leaf++) write_leaf(leaf);
+            } else {
+                auto leaves = reinterpret_cast<std::byte*>(m_tree.leaves().data());
+                task_group tasks{};
+                for (std::size_t first = 0; first < elements.size(); first += batch_hash_size) {
+                    auto batch = elements.subspan(first, std::min(batch_hash_size, elements.size() - first));
+                    auto hash_batch = [leaves, first, batch] {
+                        hash_element_roots(leaves + first * BYTES_PER_CHUNK, batch);
+                    };
+                    if (cpu_count > 1 && first + batch.size() < elements.size())
+                        tasks.run(hash_batch);
+                    else
+                        hash_batch();
+                }
+                tasks.wait();
+            }
+            m_tree.mark_all_dirty();
+        } else {
+            std::ranges::for_each(m_dirty, [](auto& idx) { idx /= per_leaf; });
+            std::ranges::sort(m_dirty);
+            auto [first, last] = std::ranges::unique(m_dirty);
+            m_dirty.erase(first, last);
+            for (auto leaf : m_dirty) {
+                if (leaf >= leaf_count) break;
+                write_leaf(leaf);
+                m_tree.mark_dirty(leaf);
+            }
+        }
+        m_dirty.clear();
+        m_all_dirty = false;
+        return m_tree.root();
+    }
+
+    // the tree of the given elements with all its nodes up to date
+    const merkle_tree& tree(std::span<const T> elements, std::size_t cpu_count = 1) const {
+        root(elements, cpu_count);
+        return m_tree;
+    }
+};
+
+/**
+ * \brief writes consecutively at out the roots of count elements, in batches of batch_hash_size on up to cpu_count
+ * threads.
+ *
+ * write_roots(out, first, count) writes at out the roots of the count elements from first; it is called concurrently
+ * for different batches.
+ */
+void batch_element_roots(std::byte* out, std::size_t count, std::size_t cpu_count, const auto& write_roots) {
+    task_group tasks{};
+    for (std::size_t first = 0; first < count; first += batch_hash_size) {
+        auto batch_size = std::min(batch_hash_size, count - first);
+        auto hash_batch = [&write_roots, out, first, batch_size] {
+            write_roots(out + first * BYTES_PER_CHUNK, first, batch_size);
+        };
+        if (cpu_count > 1 && first + batch_size < count)
+            tasks.run(hash_batch);
+        else
+            hash_batch();
+    }
+    tasks.wait();
+}
+
+/**
+ * \brief the element roots of a list of composite types and their tree, kept between hashes of the list.
+ *
+ * Elements are marked written concurrently through dirty_elements, root() rehashes only the marked elements and their
+ * paths. write_roots is as in batch_element_roots. The cache is updated by one thread at a time, see update_flag.
+ */
+template <std::size_t N>
+class element_root_cache : public dirty_elements {
+   private:
+    update_flag m_updating;
+    merkle_tree m_tree{helpers::log2ceil(N)};
+
+    void update(std::size_t count, std::size_t cpu_count, const auto& write_roots) {
+        reserve(count);
+        if (m_tree.size() != count) m_tree.resize(count);
+        auto leaves = reinterpret_cast<std::byte*>(m_tree.leaves().data());
+        if (all_dirty()) {
+            batch_element_roots(leaves, count, cpu_count, write_roots);
+            m_tree.mark_all_dirty();
+        } else {
+            auto marked = dirty(count);
+            for (auto run = std::begin(marked); run != std::end(marked);) {
+                auto run_end = std::adjacent_find(run, std::end(marked), [](auto a, auto b) { return b != a + 1; });
+                if (run_end != std::end(marked)) run_end++;
+                write_roots(leaves + *run * BYTES_PER_CHUNK, *run, static_cast<std::size_t>(run_end - run));
+                std::for_each(run, run_end, [this](auto idx) { m_tree.mark_dirty(idx); });
+                run = run_end;
+            }
+        }
+        clear();
+    }
+
+   public:
+    /**
+     * \brief the root of the tree of the count elements, rehashing only the elements marked since the last call.
+     *
+     * When every element is dirty their roots are computed in batches on up to cpu_count threads. Returns nothing if
+     * the cache is being updated, in which case the caller hashes the elements without it.
+     */
+    std::optional<chunk_t> root(std::size_t count, std::size_t cpu_count, const auto& write_roots) {
+        std::unique_lock lock{m_updating, std::try_to_lock};
+        if (!lock) return std::nullopt;
+        update(count, cpu_count, write_roots);
+        return m_tree.root();
+    }
+
+    // the tree of the count elements with all its nodes up to date, waits for a running update
+    const merkle_tree& tree(std::size_t count, std::size_t cpu_count, const auto& write_roots) {
+        std::lock_guard lock{m_updating};
+        update(count, cpu_count, write_roots);
+        m_tree.root();
+        return m_tree;
+    }
+};
+
+// writes consecutively at out the roots of the count elements of r from first
+template <std::ranges::contiguous_range R>
+    requires(!basic_type<std::ranges::range_value_t<R>>)
+void element_roots(const R& r, std::byte* out, std::size_t first, std::size_t count) {
+    hash_element_roots(out, std::span{std::ranges::data(r) + first, count});
+}
+
+// lists that compute the roots of their elements themselves, such as soa_list
+template <class R>
+    requires requires(const R& r, std::byte* out) { r.element_roots(out, 0, 0); }
+void element_roots(const R& r, std::byte* out, std::size_t first, std::size_t count) {
+    r.element_roots(out, first, count);
+}
+}  // namespace _detail
+
 // helper hash_tree_root of non-basic, 32 bytes, or boolean vectors
 template <ssz_iterator I, ssz_vector R>
     requires(!std::is_same_v<Root, std::remove_cvref_t<std::ranges::range_value_t<R>>> && !ssz_basic_type_vector<R>)
 auto hash_tree_root(I result, const R& r, size_t cpu_count = 0, size_t limit = 0) {
     auto rsize = std::ranges::size(r);
-    if (cpu_count == 0) cpu_count = std::thread::hardware_concurrency();
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
     if (cpu_count < 2 || rsize < 4) {
-        std::vector<std::byte> chunks(std::ranges::size(r) * BYTES_PER_CHUNK);
-        auto offset = std::begin(chunks);
-        std::ranges::for_each(r, [&offset](auto& elem) {
-            hash_tree_root(offset, elem, 1);
-            std::advance(offset, BYTES_PER_CHUNK);
-        });
-        return hash_tree_root(result, chunks, 1, limit);
+        _detail::scratch_buffer chunks{rsize * BYTES_PER_CHUNK};
+        _detail::hash_element_roots(chunks.data(), r);
+        return _detail::merkleize_chunks(result, chunks.data(), chunks.size(), limit);
     }
     auto half_size = std::bit_ceil(rsize) / 2;
     auto first = std::ranges::subrange(std::begin(r), std::begin(r) + half_size);
     auto last = std::ranges::subrange(std::begin(r) + half_size, std::end(r));
-    std::vector<std::byte> two_blocks(2 * BYTES_PER_CHUNK);  // has to be on the heap
-    auto future = std::async(std::launch::async, [&]() {
-        hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, cpu_count / 2, half_size);
-    });
-    hash_tree_root(std::begin(two_blocks), first, cpu_count / 2, half_size);
-    future.get();
+    _detail::scratch_buffer two_blocks{2 * BYTES_PER_CHUNK};
+    // odd core counts round up, the extra task is balanced by work stealing
+    auto half_cpus = (cpu_count + 1) / 2;
+    task_group tasks{};
+    tasks.run([&]() { hash_tree_root(std::begin(two_blocks) + BYTES_PER_CHUNK, last, half_cpus, half_size); });
+    hash_tree_root(std::begin(two_blocks), first, half_cpus, half_size);
+    tasks.wait();
     hash(result, two_blocks, 1);
     for (auto i = helpers::log2ceil(half_size) + 1; i < helpers::log2ceil(limit); i++) {
         hash_2_chunks(result, result, zero_hash_array[i]);
@@ -321,32 +773,43 @@ auto hash_tree_root(ssz_iterator auto result, const ssz::list<T, N>& r, size_t c
     auto hash = hash_tree_root(r.data(), cpu_count, limit);
     mix_in_length(result, std::begin(hash), r.size());
 }
+// lists of composite types with a root cache rehash only the elements written since their last hash
 template <ssz_object T, size_t N>
     requires(!basic_type<T>)
 auto hash_tree_root(ssz_iterator auto result, const ssz::list<T, N>& r, size_t cpu_count = 0) {
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    if (auto cache = r.root_cache()) {
+        auto hash = cache->root(r.size(), cpu_count, [&r](std::byte* out, auto first, auto count) {
+            _detail::element_roots(r, out, first, count);
+        });
+        if (hash) return mix_in_length(result, std::begin(*hash), r.size());
+    }
     auto hash = hash_tree_root(r.data(), cpu_count, N);
     return mix_in_length(result, std::begin(hash), r.size());
 }
 template <size_t N>
 auto hash_tree_root(ssz_iterator auto result, const ssz::list<bool, N>& r, size_t cpu_count = 1) {
-    auto bytes = serialize(r);
+    _detail::scratch_buffer bytes{r.size() / CHAR_BIT + 1};
+    serialize(bytes.begin(), r);
     // remove the last bit on the list
-    auto& last = bytes.back();
+    auto byte_length = bytes.size();
+    auto& last = bytes.data()[byte_length - 1];
     auto highest_bit = CHAR_BIT - std::countl_zero(static_cast<unsigned char>(last)) - 1;
     if (highest_bit == 0) {
-        bytes.pop_back();
+        byte_length--;
     } else {
         last &= ~(std::byte{1} << highest_bit);
     }
     size_t limit = (N + CHAR_BIT * BYTES_PER_CHUNK - 1) / (CHAR_BIT * BYTES_PER_CHUNK);
-    auto hash = hash_tree_root(bytes, cpu_count, limit);
+    auto hash = hash_tree_root(std::span<const std::byte>{bytes.data(), byte_length}, cpu_count, limit);
     mix_in_length(result, std::begin(hash), r.size());
 }
 
 // hash_tree_root of std::bitset<N>
 template <size_t N>
 auto hash_tree_root(ssz_iterator auto result, const std::bitset<N>& r, size_t cpu_count = 1) {
-    auto bytes = serialize(r);
+    std::array<std::byte, (N + CHAR_BIT - 1) / CHAR_BIT> bytes{};
+    serialize(std::begin(bytes), r);
     size_t limit = (N + CHAR_BIT * BYTES_PER_CHUNK - 1) / (CHAR_BIT * BYTES_PER_CHUNK);
     hash_tree_root(result, bytes, cpu_count, limit);
 }
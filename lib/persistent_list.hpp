@@ -0,0 +1,557 @@
+/*  persistent_list.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <compare>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#ifdef HAVE_YAML
+#include <yaml-cpp/yaml.h>
+#endif
+
+#include "lists.hpp"
+#include "math.hpp"
+#include "merkleize.hpp"
+
+namespace ssz {
+namespace _detail {
+/**
+ * \brief a node of the tree of a persistent_list, shared between all the versions of the list that contain it.
+ *
+ * Leaves hold a block of consecutive elements, internal nodes hold two children, a missing right child stands for
+ * a subtree past the end of the list. Nodes are never modified once built, except for their root which is computed
+ * the first time it is needed.
+ */
+template <class T>
+struct persistent_node {
+    std::array<std::shared_ptr<const persistent_node>, 2> children{};
+    std::vector<T> elements{};
+    mutable chunk_t root{};
+    mutable std::once_flag hashed{};
+};
+}  // namespace _detail
+
+/**
+ * \brief an SSZ list of at most N elements stored in a persistent balanced tree aligned with its Merkle tree.
+ *
+ * Copies share the whole tree. Writing an element copies only the path from the root to the block holding it, that
+ * is O(log n) nodes, so that many versions of a large list can be kept at the cost of their differences. Each node
+ * keeps its hash tree root, so hashing a new version only rehashes the copied paths.
+ *
+ * Elements are read with operator[] or iterators and written with set(), update() or push_back(). The list can be
+ * hashed concurrently from different threads, also through different copies.
+ */
+template <ssz_object T, std::size_t N>
+    requires(!std::is_same_v<T, bool>)
+class persistent_list {
+   private:
+    using node = _detail::persistent_node<T>;
+    using node_ptr = std::shared_ptr<const node>;
+
+   public:
+    // elements packed per chunk of the Merkle tree
+    static constexpr std::size_t per_chunk = basic_type<T> ? BYTES_PER_CHUNK / sizeof(T) : 1;
+    static constexpr std::size_t chunk_limit = (N + per_chunk - 1) / per_chunk;
+    static constexpr std::size_t limit_depth = helpers::log2ceil(chunk_limit);
+    // each leaf of the tree covers a subtree of 2^leaf_depth chunks
+    static constexpr std::size_t leaf_depth = std::min(limit_depth, std::size_t{4});
+    static constexpr std::size_t leaf_chunks = std::size_t{1} << leaf_depth;
+    static constexpr std::size_t leaf_size = leaf_chunks * per_chunk;
+
+   private:
+    node_ptr m_root{};
+    std::size_t m_size{};
+    // number of internal levels above the leaves
+    std::size_t m_depth{};
+
+    const node& leaf(std::size_t block) const {
+        const auto* ret = m_root.get();
+        for (auto level = m_depth; level > 0; level--) ret = ret->children[(block >> (level - 1)) & 1].get();
+        return *ret;
+    }
+
+    // copies of the nodes from n to the given block, f is called on the elements of the copied leaf
+    static node_ptr copy_path(const node_ptr& n, std::size_t level, std::size_t block, const auto& f) {
+        auto ret = std::make_shared<node>();
+        if (n) {
+            ret->children = n->children;
+            if (level == 0) ret->elements = n->elements;
+        }
+        if (level == 0) {
+            f(ret->elements);
+        } else {
+            auto& child = ret->children[(block >> (level - 1)) & 1];
+            child = copy_path(child, level - 1, block, f);
+        }
+        return ret;
+    }
+
+    // the subtree at the given level holding the first count elements of the tree made of copies of full[0]
+    static node_ptr filled(const std::vector<node_ptr>& full, std::size_t level, std::size_t count) {
+        if (count == leaf_size << level) return full[level];
+        auto ret = std::make_shared<node>();
+        if (level == 0) {
+            ret->elements.assign(full[0]->elements.begin(), full[0]->elements.begin() + count);
+            return ret;
+        }
+        auto half = leaf_size << (level - 1);
+        ret->children[0] = filled(full, level - 1, std::min(count, half));
+        if (count > half) ret->children[1] = filled(full, level - 1, count - half);
+        return ret;
+    }
+
+    static void leaf_chunks_of(std::byte* chunks, const node& n) {
+        if constexpr (basic_type<T>)
+            serialize(chunks, n.elements);
+        else
+            _detail::hash_element_roots(chunks, n.elements);
+    }
+
+    static const chunk_t& node_root(const node_ptr& n, std::size_t level) {
+        if (!n) return zero_hash_array[leaf_depth + level];
+        std::call_once(n->hashed, [&n, level] {
+            if (level == 0) {
+                std::array<chunk_t, leaf_chunks> chunks{};
+                leaf_chunks_of(reinterpret_cast<std::byte*>(chunks.data()), *n);
+                auto byte_length = basic_type<T> ? n->elements.size() * sizeof(T)
+                                                 : n->elements.size() * BYTES_PER_CHUNK;
+                _detail::merkleize_chunks(std::begin(n->root), reinterpret_cast<const std::byte*>(chunks.data()),
+                                          byte_length, leaf_chunks);
+            } else {
+                hash_2_chunks(std::begin(n->root), node_root(n->children[0], level - 1),
+                              node_root(n->children[1], level - 1));
+            }
+        });
+        return n->root;
+    }
+
+   public:
+    class const_iterator {
+       private:
+        const persistent_list* m_list{};
+        std::size_t m_pos{};
+        const T* m_block{};
+
+        void load() { m_block = m_pos < m_list->size() ? m_list->leaf(m_pos / leaf_size).elements.data() : nullptr; }
+
+       public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        const_iterator() = default;
+        const_iterator(const persistent_list* list, std::size_t pos) : m_list{list}, m_pos{pos} { load(); }
+
+        const T& operator*() const { return m_block[m_pos % leaf_size]; }
+        const T* operator->() const { return m_block + m_pos % leaf_size; }
+        const_iterator& operator++() {
+            if (++m_pos % leaf_size == 0) load();
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+        bool operator==(const const_iterator& rhs) const noexcept { return m_pos == rhs.m_pos; }
+    };
+
+    persistent_list() = default;
+    persistent_list(const std::vector<T>& list) { assign(list); }
+    /**
+     * \brief a list of count copies of value.
+     *
+     * Full subtrees are all the same node, so that the list takes O(log count) nodes until it is written to.
+     * Throws std::length_error if count is larger than N.
+     */
+    persistent_list(std::size_t count, const T& value) {
+        if (count > N) throw std::length_error("persistent_list exceeds its limit");
+        if (count == 0) return;
+        m_size = count;
+        m_depth = helpers::log2ceil((count + leaf_size - 1) / leaf_size);
+        std::vector<node_ptr> full{};
+        auto block = std::make_shared<node>();
+        block->elements.assign(leaf_size, value);
+        full.push_back(std::move(block));
+        for (std::size_t level = 1; level <= m_depth; level++) {
+            auto parent = std::make_shared<node>();
+            parent->children = {full.back(), full.back()};
+            full.push_back(std::move(parent));
+        }
+        m_root = filled(full, m_depth, count);
+    }
+
+    auto begin() const { return const_iterator{this, 0}; }
+    auto cbegin() const { return begin(); }
+    auto end() const { return const_iterator{this, m_size}; }
+    auto cend() const { return end(); }
+    auto size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    static constexpr auto limit() noexcept { return N; }
+
+    const T& operator[](std::size_t pos) const { return leaf(pos / leaf_size).elements[pos % leaf_size]; }
+
+    /**
+     * \brief replaces the elements of the list, building the tree bottom up.
+     *
+     * Throws std::length_error if there are more than N elements.
+     */
+    void assign(std::span<const T> elements) {
+        if (elements.size() > N) throw std::length_error("persistent_list exceeds its limit");
+        std::vector<node_ptr> layer{};
+        for (std::size_t first = 0; first < elements.size(); first += leaf_size) {
+            auto block = std::make_shared<node>();
+            block->elements.assign(elements.begin() + first,
+                                   elements.begin() + std::min(first + leaf_size, elements.size()));
+            layer.push_back(std::move(block));
+        }
+        m_size = elements.size();
+        m_depth = helpers::log2ceil(layer.size());
+        for (std::size_t level = 0; level < m_depth; level++) {
+            std::vector<node_ptr> parents{};
+            for (std::size_t i = 0; i < layer.size(); i += 2) {
+                auto parent = std::make_shared<node>();
+                parent->children[0] = std::move(layer[i]);
+                if (i + 1 < layer.size()) parent->children[1] = std::move(layer[i + 1]);
+                parents.push_back(std::move(parent));
+            }
+            layer = std::move(parents);
+        }
+        m_root = layer.empty() ? nullptr : std::move(layer.front());
+    }
+    void reset(std::vector<T>& vec) {
+        assign(vec);
+        vec.clear();
+    }
+
+    // calls f on a copy of the element at pos and stores it, the other versions of the list are unaffected
+    void update(std::size_t pos, const auto& f) {
+        if (pos >= m_size) throw std::out_of_range("persistent_list index out of range");
+        m_root = copy_path(m_root, m_depth, pos / leaf_size, [&](auto& elements) { f(elements[pos % leaf_size]); });
+    }
+    void set(std::size_t pos, const T& value) {
+        update(pos, [&value](T& elem) { elem = value; });
+    }
+    void push_back(const T& value) {
+        if (m_size == N) throw std::length_error("persistent_list exceeds its limit");
+        if (m_root && m_size == leaf_size << m_depth) {
+            auto root = std::make_shared<node>();
+            root->children[0] = std::move(m_root);
+            m_root = std::move(root);
+            m_depth++;
+        }
+        m_root = copy_path(m_root, m_depth, m_size / leaf_size, [&](auto& elements) { elements.push_back(value); });
+        m_size++;
+    }
+
+    // the root of the tree of the elements, without the length mixed in
+    chunk_t data_root() const {
+        if (!m_root) return zero_hash_array[limit_depth];
+        auto ret = node_root(m_root, m_depth);
+        for (auto height = leaf_depth + m_depth; height < limit_depth; height++)
+            hash_2_chunks(std::begin(ret), ret, zero_hash_array[height]);
+        return ret;
+    }
+
+    /**
+     * \brief a view of the Merkle tree of the list, used by the proof functions.
+     *
+     * node(height, index) is the node at the given height (0 for the chunks) and index of the tree of limit_depth
+     * levels, nodes below the leaves of the persistent tree are merkleized when asked for.
+     */
+    class tree_view {
+       private:
+        const persistent_list& m_list;
+
+       public:
+        explicit tree_view(const persistent_list& list) : m_list{list} {}
+
+        chunk_t node(std::size_t height, std::size_t index) const {
+            const auto& list = m_list;
+            if (height >= leaf_depth + list.m_depth) {
+                if (index > 0 || !list.m_root) return zero_hash_array[height];
+                auto ret = node_root(list.m_root, list.m_depth);
+                for (auto h = leaf_depth + list.m_depth; h < height; h++)
+                    hash_2_chunks(std::begin(ret), ret, zero_hash_array[h]);
+                return ret;
+            }
+            auto level = height >= leaf_depth ? height - leaf_depth : 0;
+            auto block = height >= leaf_depth ? index : index >> (leaf_depth - height);
+            if (block >> (list.m_depth - level)) return zero_hash_array[height];
+            const auto* n = &list.m_root;
+            for (auto l = list.m_depth; l > level && *n; l--) n = &(*n)->children[(block >> (l - level - 1)) & 1];
+            if (height >= leaf_depth) return node_root(*n, level);
+            if (!*n) return zero_hash_array[height];
+            std::array<chunk_t, leaf_chunks> chunks{};
+            leaf_chunks_of(reinterpret_cast<std::byte*>(chunks.data()), **n);
+            for (std::size_t h = 0; h < height; h++) {
+                for (std::size_t i = 0; i < leaf_chunks >> (h + 1); i++)
+                    hash_2_chunks(std::begin(chunks[i]), chunks[2 * i], chunks[2 * i + 1]);
+            }
+            return chunks[index % (leaf_chunks >> height)];
+        }
+    };
+    auto tree() const { return tree_view{*this}; }
+
+    // whether both lists are the same version, in which case they are equal
+    bool shares_with(const persistent_list& other) const noexcept {
+        return m_root == other.m_root && m_size == other.m_size;
+    }
+
+    struct variable_size : std::true_type {};
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = const_iterator;
+
+    auto operator<=>(const persistent_list& rhs) const {
+        return std::lexicographical_compare_three_way(begin(), end(), rhs.begin(), rhs.end());
+    }
+    bool operator==(const persistent_list& rhs) const {
+        return shares_with(rhs) || (m_size == rhs.m_size && std::equal(begin(), end(), rhs.begin()));
+    }
+};
+
+namespace _detail {
+template <ssz_object T, std::size_t N>
+struct list_traits<persistent_list<T, N>> : list_traits<list<T, N>> {};
+}  // namespace _detail
+
+// serialize in place lists of fixed size objects, one block at a time
+template <ssz_object_fixed_size T, std::size_t N>
+auto serialize(std::weakly_incrementable auto result, const persistent_list<T, N>& r)
+    requires std::is_same_v<decltype(*result), std::byte&>
+{
+    for (std::size_t first = 0; first < r.size(); first += r.leaf_size)
+        result = serialize(result, std::span<const T>{&r[first], std::min(r.leaf_size, r.size() - first)});
+    return result;
+}
+
+// Deserialization
+template <ssz_object T, std::size_t N>
+void deserialize(const serialized_range auto& bytes, persistent_list<T, N>& ret) {
+    std::vector<T> elements{};
+    deserialize(bytes, elements);
+    if (elements.size() > N) throw std::invalid_argument("list exceeds its limit");
+    ret.reset(elements);
+}
+
+// hash_tree_root of persistent lists
+template <ssz_object T, std::size_t N>
+void hash_tree_root(ssz_iterator auto result, const persistent_list<T, N>& r, size_t = 0, size_t = 0) {
+    mix_in_length(result, std::begin(r.data_root()), r.size());
+}
+
+template <ssz_object T, std::size_t N>
+auto hash_tree_root(const persistent_list<T, N>& r, size_t = 0) {
+    chunk_t ret{};
+    hash_tree_root(std::begin(ret), r);
+    return ret;
+}
+
+/**
+ * \brief an SSZ vector of N elements stored in the persistent tree of a persistent_list.
+ *
+ * Meant for the vectors written one index at a time and kept in many versions, such as the ring buffers of a state
+ * indexed by slot or epoch. Writing an element with set() or update() copies the O(log N) nodes on its path, and
+ * hashing the new version rehashes only those, so that neither copying the vector nor its root after a write scale
+ * with N. Default constructed vectors share a single tree of default elements.
+ *
+ * The non-const operator[] returns an element_reference, so that code written for std::array such as v[i] = x,
+ * v[i][j] = x or v[i] += x keeps compiling and goes through set() or update(). It cannot hand out a T&, use
+ * std::as_const(v)[i] or get() where one is needed.
+ */
+template <ssz_object T, std::size_t N>
+    requires(!std::is_same_v<T, bool>)
+class persistent_vector {
+   private:
+    persistent_list<T, N> m_elements{zero()};
+
+    static const persistent_list<T, N>& zero() {
+        static const persistent_list<T, N> ret(N, T{});
+        return ret;
+    }
+
+   public:
+    using const_iterator = typename persistent_list<T, N>::const_iterator;
+    static constexpr std::size_t leaf_size = persistent_list<T, N>::leaf_size;
+
+    persistent_vector() = default;
+    persistent_vector(const std::array<T, N>& elements) { m_elements.assign(elements); }
+
+    auto begin() const { return m_elements.begin(); }
+    auto cbegin() const { return begin(); }
+    auto end() const { return m_elements.end(); }
+    auto cend() const { return end(); }
+    static constexpr auto size() noexcept { return N; }
+
+    /**
+     * \brief the element at a position of a persistent_vector, reading the current version and writing through set()
+     * or update().
+     */
+    class element_reference {
+       private:
+        persistent_vector* m_vector;
+        std::size_t m_pos;
+
+        // an element of a vector element, written by updating the whole element
+        class nested_reference {
+           private:
+            element_reference m_parent;
+            std::size_t m_idx;
+
+           public:
+            using value_type = typename T::value_type;
+
+            nested_reference(element_reference parent, std::size_t idx) noexcept : m_parent{parent}, m_idx{idx} {}
+            const value_type& get() const { return m_parent.get()[m_idx]; }
+            operator const value_type&() const { return get(); }
+            nested_reference& operator=(const value_type& value) {
+                m_parent.m_vector->update(m_parent.m_pos, [this, &value](T& elem) { elem[m_idx] = value; });
+                return *this;
+            }
+            nested_reference& operator=(const nested_reference& rhs) { return *this = rhs.get(); }
+            bool operator==(const value_type& rhs) const { return get() == rhs; }
+        };
+
+       public:
+        element_reference(persistent_vector* vector, std::size_t pos) noexcept : m_vector{vector}, m_pos{pos} {}
+
+        const T& get() const { return std::as_const(*m_vector)[m_pos]; }
+        operator const T&() const { return get(); }
+        element_reference& operator=(const T& value) {
+            m_vector->set(m_pos, value);
+            return *this;
+        }
+        // assigns the value of rhs, as a T& would
+        element_reference& operator=(const element_reference& rhs) { return *this = T{rhs.get()}; }
+        element_reference& operator+=(const T& value)
+            requires std::is_arithmetic_v<T>
+        {
+            m_vector->update(m_pos, [&value](T& elem) { elem += value; });
+            return *this;
+        }
+        element_reference& operator-=(const T& value)
+            requires std::is_arithmetic_v<T>
+        {
+            m_vector->update(m_pos, [&value](T& elem) { elem -= value; });
+            return *this;
+        }
+        auto operator[](std::size_t idx) const
+            requires requires { typename T::value_type; }
+        {
+            return nested_reference{*this, idx};
+        }
+        bool operator==(const T& rhs) const { return get() == rhs; }
+    };
+
+    const T& operator[](std::size_t pos) const { return m_elements[pos]; }
+    element_reference operator[](std::size_t pos) { return element_reference{this, pos}; }
+
+    // replaces all the elements, throws std::invalid_argument unless there are exactly N of them
+    void assign(std::span<const T> elements) {
+        if (elements.size() != N) throw std::invalid_argument("wrong number of elements for a vector");
+        m_elements.assign(elements);
+    }
+    // calls f on a copy of the element at pos and stores it, the other versions of the vector are unaffected
+    void update(std::size_t pos, const auto& f) { m_elements.update(pos, f); }
+    void set(std::size_t pos, const T& value) { m_elements.set(pos, value); }
+
+    auto root() const { return m_elements.data_root(); }
+    // a view of the Merkle tree of the vector, used by the proof functions
+    auto tree() const { return m_elements.tree(); }
+    // whether both vectors are the same version, in which case they are equal
+    bool shares_with(const persistent_vector& other) const noexcept {
+        return m_elements.shares_with(other.m_elements);
+    }
+
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using iterator = const_iterator;
+
+    auto operator<=>(const persistent_vector& rhs) const { return m_elements <=> rhs.m_elements; }
+    bool operator==(const persistent_vector& rhs) const { return m_elements == rhs.m_elements; }
+};
+
+namespace _detail {
+template <ssz_object T, std::size_t N>
+struct vector_traits<persistent_vector<T, N>> : vector_traits<std::array<T, N>> {};
+}  // namespace _detail
+
+// serialize in place vectors of fixed size objects, one block at a time
+template <ssz_object_fixed_size T, std::size_t N>
+auto serialize(std::weakly_incrementable auto result, const persistent_vector<T, N>& r)
+    requires std::is_same_v<decltype(*result), std::byte&>
+{
+    for (std::size_t first = 0; first < N; first += r.leaf_size)
+        result = serialize(result, std::span<const T>{&r[first], std::min(r.leaf_size, N - first)});
+    return result;
+}
+
+template <ssz_object T, std::size_t N>
+void deserialize(const serialized_range auto& bytes, persistent_vector<T, N>& ret) {
+    auto elements = std::make_unique<std::array<T, N>>();
+    deserialize(bytes, *elements);
+    ret.assign(*elements);
+}
+
+// hash_tree_root of persistent vectors
+template <ssz_object T, std::size_t N>
+void hash_tree_root(ssz_iterator auto result, const persistent_vector<T, N>& r, size_t = 0, size_t = 0) {
+    std::ranges::copy(r.root(), result);
+}
+
+template <ssz_object T, std::size_t N>
+auto hash_tree_root(const persistent_vector<T, N>& r, size_t = 0) {
+    return r.root();
+}
+}  // namespace ssz
+
+#ifdef HAVE_YAML
+template <ssz::ssz_object T, size_t N>
+struct YAML::convert<ssz::persistent_list<T, N>> {
+    static bool decode(const YAML::Node& node, ssz::persistent_list<T, N>& r) {
+        std::vector<T> elements{};
+        if (!YAML::convert<std::vector<T>>::decode(node, elements)) return false;
+        r.reset(elements);
+        return true;
+    }
+};
+
+template <ssz::ssz_object T, size_t N>
+struct YAML::convert<ssz::persistent_vector<T, N>> {
+    static bool decode(const YAML::Node& node, ssz::persistent_vector<T, N>& r) {
+        std::vector<T> elements{};
+        if (!YAML::convert<std::vector<T>>::decode(node, elements) || elements.size() != N) return false;
+        r.assign(elements);
+        return true;
+    }
+};
+#endif
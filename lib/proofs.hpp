@@ -0,0 +1,534 @@
+/*  proofs.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "cached_tree.hpp"
+#include "container.hpp"
+#include "merkleize.hpp"
+
+namespace ssz {
+/**
+ * \brief generalized index of a node in the Merkle tree of an object, as defined in
+ * https://github.com/ethereum/consensus-specs/blob/dev/ssz/merkle-proofs.md
+ *
+ * The root has index 1 and the children of the node n are 2n and 2n + 1.
+ */
+using gindex_t = std::uint64_t;
+
+// path element selecting the length mixed in the root of a list
+constexpr std::size_t length_index{std::numeric_limits<std::size_t>::max()};
+
+/**
+ * \brief a Merkle proof for a single node: its value and the sibling nodes on its path, from the bottom up.
+ */
+struct merkle_proof {
+    chunk_t leaf;
+    std::vector<chunk_t> branch;
+};
+
+/**
+ * \brief a Merkle multiproof: the values of the proven nodes, in the order of their indices, and the helper nodes, in
+ * the order of get_helper_indices.
+ */
+struct merkle_multiproof {
+    std::vector<chunk_t> leaves;
+    std::vector<chunk_t> proof;
+};
+
+namespace _detail {
+template <class T>
+concept cached_sequence = requires(const T& t) { t.tree(); };
+
+// lists of composite types that can keep the tree of their element roots
+template <class T>
+concept root_cached_list = list_traits<T>::value && !basic_type<typename list_traits<T>::value_type> &&
+                           requires(const T& t) { t.root_cache(); };
+
+// the elements of a list or a vector, hashed as a vector
+template <class T>
+const auto& data_elements(const T& obj) {
+    if constexpr (list_traits<T>::value)
+        return obj.data();
+    else
+        return obj;
+}
+
+// number of leaves of the data tree of a list or vector of T with limit elements
+template <class T>
+constexpr std::size_t data_leaf_limit(std::size_t limit) {
+    if constexpr (basic_type<T>)
+        return (limit * sizeof(T) + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK;
+    else
+        return limit;
+}
+
+constexpr std::size_t gindex_depth(gindex_t gindex) { return std::bit_width(gindex) - 1; }
+
+// generalized index of the node that sits at gindex inside the subtree rooted at the node root
+constexpr gindex_t concat_gindices(gindex_t root, gindex_t gindex) {
+    auto depth = gindex_depth(gindex);
+    if (gindex_depth(root) + depth >= std::numeric_limits<gindex_t>::digits)
+        throw std::out_of_range("generalized index too deep");
+    return (root << depth) | (gindex ^ (gindex_t{1} << depth));
+}
+
+// the generalized index relative to the node at depth levels below the root on its path
+constexpr gindex_t drop_gindex_levels(gindex_t gindex, std::size_t depth) {
+    auto remaining = gindex_depth(gindex) - depth;
+    return (gindex_t{1} << remaining) | (gindex & ((gindex_t{1} << remaining) - 1));
+}
+
+// index of the node at depth levels below the root on the path to gindex
+constexpr std::size_t gindex_prefix(gindex_t gindex, std::size_t depth) {
+    auto length = gindex_depth(gindex);
+    return (gindex >> (length - depth)) ^ (gindex_t{1} << depth);
+}
+
+// the generalized indices of the branch of gindex, bottom-up
+inline std::vector<gindex_t> branch_indices(gindex_t gindex) {
+    std::vector<gindex_t> ret{};
+    for (; gindex > 1; gindex >>= 1) ret.push_back(gindex ^ 1);
+    return ret;
+}
+
+// a node requested from the tree of an object, its generalized index is relative to the root of that object
+struct node_request {
+    gindex_t gindex;
+    chunk_t* node;
+};
+
+/**
+ * \brief all the occupied layers of the tree with the given leaves and depth, the missing nodes are zero hashes.
+ */
+class tree_layers {
+   private:
+    std::vector<std::vector<chunk_t>> m_layers;
+
+   public:
+    tree_layers(std::vector<chunk_t>&& leaves, std::size_t depth) : m_layers(depth + 1) {
+        m_layers[0] = std::move(leaves);
+        for (std::size_t height = 1; height <= depth; height++) {
+            const auto& children = m_layers[height - 1];
+            auto& parents = m_layers[height];
+            parents.resize((children.size() + 1) / 2);
+            if (children.size() > 1)
+                hash(reinterpret_cast<std::byte*>(parents.data()), reinterpret_cast<const std::byte*>(children.data()),
+                     children.size() / 2);
+            if (children.size() & 1)
+                hash_2_chunks(std::begin(parents.back()), children.back(), zero_hash_array[height - 1]);
+        }
+    }
+
+    const chunk_t& operator()(std::size_t height, std::size_t index) const {
+        const auto& layer = m_layers[height];
+        return index < layer.size() ? layer[index] : zero_hash_array[height];
+    }
+};
+
+constexpr bool is_shallow(const node_request& request, std::size_t depth) {
+    return gindex_depth(request.gindex) <= depth;
+}
+
+// calls f(first, last) with the range of leaves covered by each request up to the given depth
+void for_each_covered_range(std::span<const node_request> requests, std::size_t depth, const auto& f) {
+    for (const auto& request : requests) {
+        auto length = gindex_depth(request.gindex);
+        if (length > depth) continue;
+        auto first = gindex_prefix(request.gindex, length) << (depth - length);
+        f(first, first + (std::size_t{1} << (depth - length)));
+    }
+}
+
+/**
+ * \brief answers the requests on a tree of the given depth.
+ *
+ * The requests up to that depth are written from node(height, index), height 0 being the leaves. The deeper ones are
+ * made relative to their leaf and passed to descend(leaf, requests), once per leaf. Reorders requests.
+ */
+void split_requests(std::span<node_request> requests, std::size_t depth, const auto& node, const auto& descend) {
+    auto deep = std::ranges::partition(requests, [depth](const auto& r) { return is_shallow(r, depth); });
+    for (auto& request : std::span{requests.begin(), deep.begin()}) {
+        auto length = gindex_depth(request.gindex);
+        *request.node = node(depth - length, gindex_prefix(request.gindex, length));
+    }
+    auto leaf_of = [depth](const auto& r) { return gindex_prefix(r.gindex, depth); };
+    std::span<node_request> rest{deep.begin(), deep.end()};
+    std::ranges::sort(rest, {}, leaf_of);
+    for (auto first = rest.begin(); first != rest.end();) {
+        auto leaf = leaf_of(*first);
+        auto last = std::find_if(first, rest.end(), [&](const auto& r) { return leaf_of(r) != leaf; });
+        std::for_each(first, last, [depth](auto& r) { r.gindex = drop_gindex_levels(r.gindex, depth); });
+        descend(leaf, std::span{first, last});
+        first = last;
+    }
+}
+
+template <class T>
+void collect_nodes(const T& obj, std::span<node_request> requests, std::size_t cpu_count);
+
+// answers the requests on the data tree of a list or a vector, that is, without the mixed in length
+template <class T>
+void collect_data_nodes(const T& obj, std::span<node_request> requests, std::size_t cpu_count) {
+    using traits = std::conditional_t<list_traits<T>::value, list_traits<T>, vector_traits<T>>;
+    using value_type = typename traits::value_type;
+    constexpr auto leaf_limit = data_leaf_limit<value_type>(traits::limit);
+    constexpr auto depth = helpers::log2ceil(leaf_limit);
+    auto descend = [&](std::size_t leaf, std::span<node_request> sub) {
+        if constexpr (basic_type<value_type>) {
+            throw std::invalid_argument("generalized index goes below a leaf");
+        } else {
+            if (leaf >= std::ranges::size(obj)) throw std::out_of_range("generalized index past the end of the list");
+            collect_nodes(obj[leaf], sub, cpu_count);
+        }
+    };
+    if constexpr (cached_sequence<T>) {
+        const auto& tree = obj.tree();
+        split_requests(requests, depth, [&tree](auto height, auto index) { return tree.node(height, index); },
+                       descend);
+    } else {
+        auto count = std::ranges::size(obj);
+        if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+        auto write_roots = [&obj](std::byte* out, auto first, auto n) { element_roots(obj, out, first, n); };
+        if constexpr (root_cached_list<T>) {
+            if (auto cache = obj.root_cache()) {
+                const auto& tree = cache->tree(count, cpu_count, write_roots);
+                split_requests(requests, depth, [&tree](auto height, auto index) { return tree.node(height, index); },
+                               descend);
+                return;
+            }
+        }
+        if constexpr (std::ranges::contiguous_range<T>) {
+            if (std::ranges::all_of(requests, [](const auto& r) { return r.gindex == 1; })) {
+                for (auto& request : requests)
+                    hash_tree_root(std::begin(*request.node), data_elements(obj), cpu_count, leaf_limit);
+                return;
+            }
+        }
+        std::vector<chunk_t> leaves{};
+        if (std::ranges::any_of(requests, [](const auto& r) { return is_shallow(r, depth); })) {
+            if constexpr (basic_type<value_type>) {
+                leaves.resize((ssz::size(data_elements(obj)) + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK);
+                serialize(reinterpret_cast<std::byte*>(leaves.data()), data_elements(obj));
+            } else {
+                leaves.resize(count);
+                batch_element_roots(reinterpret_cast<std::byte*>(leaves.data()), count, cpu_count, write_roots);
+            }
+        }
+        split_requests(requests, depth, tree_layers{std::move(leaves), depth}, descend);
+    }
+}
+
+// answers the requests on the tree of obj, merkleizing only the subtrees that are needed
+template <class T>
+void collect_nodes(const T& obj, std::span<node_request> requests, std::size_t cpu_count) {
+    auto roots = std::ranges::partition(requests, [](const auto& r) { return r.gindex == 1; });
+    if (roots.begin() != requests.begin()) {
+        hash_tree_root(std::begin(*requests.front().node), obj, cpu_count);
+        for (auto& request : std::span{requests.begin() + 1, roots.begin()}) *request.node = *requests.front().node;
+    }
+    requests = std::span{roots.begin(), roots.end()};
+    if (requests.empty()) return;
+    if constexpr (requires { obj.ssz_members(); }) {
+        auto members = obj.ssz_members();
+        constexpr auto member_count = std::tuple_size_v<decltype(members)>;
+        constexpr auto depth = helpers::log2ceil(member_count);
+        // only the members covered by a requested node are merkleized
+        std::array<bool, member_count> needed{};
+        for_each_covered_range(requests, depth, [&](auto first, auto last) {
+            std::fill(needed.begin() + std::min(first, member_count), needed.begin() + std::min(last, member_count),
+                      true);
+        });
+        std::vector<chunk_t> leaves(member_count);
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((needed[I] && (hash_tree_root(std::begin(leaves[I]), std::get<I>(members), cpu_count), true)), ...);
+        }(std::make_index_sequence<member_count>{});
+        split_requests(requests, depth, tree_layers{std::move(leaves), depth}, [&](auto member, auto sub) {
+            if (member >= member_count) throw std::invalid_argument("generalized index goes below a leaf");
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                ((I == member && (collect_nodes(std::get<I>(members), sub, cpu_count), true)) || ...);
+            }(std::make_index_sequence<member_count>{});
+        });
+    } else if constexpr (list_traits<T>::value) {
+        chunk_t length_chunk{};
+        serialize(std::begin(length_chunk), static_cast<std::uint64_t>(std::ranges::size(obj)));
+        std::optional<chunk_t> data_root{};
+        auto node = [&](auto, auto index) {
+            if (index == 1) return length_chunk;
+            if (!data_root) {
+                data_root.emplace();
+                node_request request{1, &*data_root};
+                collect_data_nodes(obj, std::span{&request, 1}, cpu_count);
+            }
+            return *data_root;
+        };
+        split_requests(requests, 1, node, [&](auto index, auto sub) {
+            if (index == 1) throw std::invalid_argument("generalized index goes below the length of a list");
+            collect_data_nodes(obj, sub, cpu_count);
+        });
+    } else if constexpr (vector_traits<T>::value) {
+        collect_data_nodes(obj, requests, cpu_count);
+    } else {
+        throw std::invalid_argument("generalized index goes below a leaf");
+    }
+}
+
+// answers the requests on the tree of obj, the generalized indices are validated first
+void collect_nodes_checked(const ssz_object auto& obj, std::span<node_request> requests, std::size_t cpu_count) {
+    if (std::ranges::any_of(requests, [](const auto& r) { return r.gindex == 0; }))
+        throw std::invalid_argument("generalized indices start at 1");
+    collect_nodes(obj, requests, cpu_count);
+}
+
+// the generalized index of the node reached by following path from the root of T
+template <class T>
+gindex_t generalized_index(std::span<const std::size_t> path) {
+    if (path.empty()) return 1;
+    auto idx = path.front();
+    auto rest = path.subspan(1);
+    if constexpr (requires(const T& t) { t.ssz_members(); }) {
+        using members_t = decltype(std::declval<const T&>().ssz_members());
+        constexpr auto member_count = std::tuple_size_v<members_t>;
+        if (idx >= member_count) throw std::out_of_range("container member index out of range");
+        gindex_t ret{};
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((I == idx && (ret = generalized_index<std::remove_cvref_t<std::tuple_element_t<I, members_t>>>(rest),
+                           true)) ||
+             ...);
+        }(std::make_index_sequence<member_count>{});
+        return concat_gindices((gindex_t{1} << helpers::log2ceil(member_count)) | idx, ret);
+    } else if constexpr (list_traits<T>::value || vector_traits<T>::value) {
+        using traits = std::conditional_t<list_traits<T>::value, list_traits<T>, vector_traits<T>>;
+        using value_type = typename traits::value_type;
+        constexpr auto depth = helpers::log2ceil(data_leaf_limit<value_type>(traits::limit));
+        gindex_t root = list_traits<T>::value ? 2 : 1;
+        if (list_traits<T>::value && idx == length_index) {
+            if (!rest.empty()) throw std::invalid_argument("path goes below the length of a list");
+            return 3;
+        }
+        if (idx >= traits::limit) throw std::out_of_range("element index out of range");
+        if constexpr (basic_type<value_type>) {
+            if (!rest.empty()) throw std::invalid_argument("path goes below a basic element");
+            return concat_gindices(root, (gindex_t{1} << depth) | (idx * sizeof(value_type) / BYTES_PER_CHUNK));
+        } else {
+            return concat_gindices(concat_gindices(root, (gindex_t{1} << depth) | idx),
+                                   generalized_index<value_type>(rest));
+        }
+    } else {
+        throw std::invalid_argument("path goes below a leaf");
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief the generalized index of the node reached from the root of T by following path.
+ *
+ * Each element of path is the index of a member of a container or of an element of a list or vector, length_index
+ * selects the length of a list. Elements of lists of basic types resolve to the chunk packing them.
+ */
+template <ssz_object T>
+gindex_t generalized_index(std::initializer_list<std::size_t> path) {
+    return _detail::generalized_index<T>(std::span{path.begin(), path.size()});
+}
+
+template <ssz_object T>
+gindex_t generalized_index(std::span<const std::size_t> path) {
+    return _detail::generalized_index<T>(path);
+}
+
+/**
+ * \brief the root of the subtree of obj at the given generalized index.
+ *
+ * Only the subtrees along the path are merkleized, the tree kept by cached lists and vectors is reused.
+ */
+chunk_t subtree_root(const ssz_object auto& obj, gindex_t gindex, std::size_t cpu_count = 0) {
+    chunk_t ret{};
+    _detail::node_request request{gindex, &ret};
+    _detail::collect_nodes_checked(obj, std::span{&request, 1}, cpu_count);
+    return ret;
+}
+
+/**
+ * \brief computes the node at gindex in the Merkle tree of obj together with its branch.
+ *
+ * Every sibling on the path is merkleized once, so the cost is bounded by one hash_tree_root of obj and is much
+ * lower when the large members are cached lists or vectors.
+ */
+merkle_proof compute_merkle_proof(const ssz_object auto& obj, gindex_t gindex, std::size_t cpu_count = 0) {
+    merkle_proof ret{};
+    auto indices = _detail::branch_indices(gindex);
+    ret.branch.resize(indices.size());
+    std::vector<_detail::node_request> requests{{gindex, &ret.leaf}};
+    for (std::size_t i = 0; i < indices.size(); i++) requests.push_back({indices[i], &ret.branch[i]});
+    _detail::collect_nodes_checked(obj, requests, cpu_count);
+    return ret;
+}
+
+/**
+ * \brief the generalized indices of the nodes that a multiproof of the given indices carries, in decreasing order.
+ *
+ * These are the siblings of the nodes on the paths to the indices that cannot be computed from the indices themselves,
+ * as get_helper_indices in the consensus specs.
+ */
+inline std::vector<gindex_t> get_helper_indices(std::span<const gindex_t> indices) {
+    std::vector<gindex_t> helpers{}, paths{};
+    for (auto gindex : indices) {
+        for (; gindex > 1; gindex >>= 1) {
+            helpers.push_back(gindex ^ 1);
+            paths.push_back(gindex);
+        }
+    }
+    auto sort_unique = [](auto& v) {
+        std::ranges::sort(v, std::greater{});
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    };
+    sort_unique(helpers);
+    sort_unique(paths);
+    std::vector<gindex_t> ret{};
+    std::ranges::set_difference(helpers, paths, std::back_inserter(ret), std::greater{});
+    return ret;
+}
+
+/**
+ * \brief computes the nodes at indices in the Merkle tree of obj together with the helper nodes needed to prove them.
+ *
+ * The helper nodes are ordered as get_helper_indices(indices). All the nodes are computed in a single pass over obj.
+ */
+merkle_multiproof compute_merkle_multiproof(const ssz_object auto& obj, std::span<const gindex_t> indices,
+                                            std::size_t cpu_count = 0) {
+    merkle_multiproof ret{};
+    auto helpers = get_helper_indices(indices);
+    ret.leaves.resize(indices.size());
+    ret.proof.resize(helpers.size());
+    std::vector<_detail::node_request> requests{};
+    for (std::size_t i = 0; i < indices.size(); i++) requests.push_back({indices[i], &ret.leaves[i]});
+    for (std::size_t i = 0; i < helpers.size(); i++) requests.push_back({helpers[i], &ret.proof[i]});
+    _detail::collect_nodes_checked(obj, requests, cpu_count);
+    return ret;
+}
+
+/**
+ * \brief the root obtained by hashing leaf with the bottom-up branch of the node at gindex.
+ */
+inline chunk_t calculate_merkle_root(const chunk_t& leaf, std::span<const chunk_t> branch, gindex_t gindex) {
+    if (branch.size() != _detail::gindex_depth(gindex))
+        throw std::invalid_argument("branch length does not match the generalized index");
+    auto ret = leaf;
+    for (const auto& sibling : branch) {
+        if (gindex & 1)
+            hash_2_chunks(std::begin(ret), sibling, ret);
+        else
+            hash_2_chunks(std::begin(ret), ret, sibling);
+        gindex >>= 1;
+    }
+    return ret;
+}
+
+inline bool verify_merkle_proof(const chunk_t& leaf, std::span<const chunk_t> branch, gindex_t gindex,
+                                const chunk_t& root) {
+    if (gindex == 0 || branch.size() != _detail::gindex_depth(gindex)) return false;
+    return calculate_merkle_root(leaf, branch, gindex) == root;
+}
+
+inline bool verify_merkle_proof(const merkle_proof& proof, gindex_t gindex, const chunk_t& root) {
+    return verify_merkle_proof(proof.leaf, proof.branch, gindex, root);
+}
+
+/**
+ * \brief the root obtained from the nodes at indices and the helper nodes of a multiproof.
+ *
+ * The known nodes are merged one layer at a time from the bottom, all the sibling pairs of a layer are hashed with a
+ * single call to hash.
+ */
+inline chunk_t calculate_multi_merkle_root(std::span<const chunk_t> leaves, std::span<const chunk_t> proof,
+                                           std::span<const gindex_t> indices) {
+    if (leaves.size() != indices.size()) throw std::invalid_argument("different number of leaves and indices");
+    auto helpers = get_helper_indices(indices);
+    if (proof.size() != helpers.size()) throw std::invalid_argument("wrong number of helper nodes");
+    using node_t = std::pair<gindex_t, chunk_t>;
+    std::vector<std::vector<node_t>> layers{};
+    auto add_node = [&layers](gindex_t gindex, const chunk_t& node) {
+        if (gindex == 0) throw std::invalid_argument("generalized indices start at 1");
+        auto depth = _detail::gindex_depth(gindex);
+        if (layers.size() <= depth) layers.resize(depth + 1);
+        layers[depth].emplace_back(gindex, node);
+    };
+    for (std::size_t i = 0; i < indices.size(); i++) add_node(indices[i], leaves[i]);
+    for (std::size_t i = 0; i < helpers.size(); i++) add_node(helpers[i], proof[i]);
+    if (layers.empty()) throw std::invalid_argument("empty multiproof");
+
+    auto sort_layer = [](auto& layer) {
+        std::ranges::stable_sort(layer, {}, &node_t::first);
+        auto [first, last] = std::ranges::unique(layer, {}, &node_t::first);
+        layer.erase(first, last);
+    };
+    std::vector<std::byte> blocks{};
+    std::vector<gindex_t> parents{};
+    std::vector<chunk_t> hashed{};
+    for (auto depth = layers.size() - 1; depth > 0; depth--) {
+        auto& layer = layers[depth];
+        auto& upper = layers[depth - 1];
+        sort_layer(layer);
+        sort_layer(upper);
+        blocks.clear();
+        parents.clear();
+        for (std::size_t i = 0; i + 1 < layer.size(); i++) {
+            auto gindex = layer[i].first;
+            if ((gindex & 1) || layer[i + 1].first != gindex + 1) continue;
+            if (std::ranges::binary_search(upper, gindex / 2, {}, &node_t::first)) continue;
+            blocks.insert(blocks.end(), layer[i].second.begin(), layer[i].second.end());
+            blocks.insert(blocks.end(), layer[i + 1].second.begin(), layer[i + 1].second.end());
+            parents.push_back(gindex / 2);
+            i++;
+        }
+        if (parents.empty()) continue;
+        hashed.resize(parents.size());
+        hash(reinterpret_cast<std::byte*>(hashed.data()), blocks.data(), parents.size());
+        for (std::size_t i = 0; i < parents.size(); i++) upper.emplace_back(parents[i], hashed[i]);
+    }
+    if (layers[0].empty()) throw std::invalid_argument("the multiproof does not reach the root");
+    return layers[0].front().second;
+}
+
+inline bool verify_merkle_multiproof(std::span<const chunk_t> leaves, std::span<const chunk_t> proof,
+                                     std::span<const gindex_t> indices, const chunk_t& root) {
+    if (leaves.size() != indices.size() || proof.size() != get_helper_indices(indices).size()) return false;
+    if (std::ranges::find(indices, gindex_t{0}) != indices.end()) return false;
+    return calculate_multi_merkle_root(leaves, proof, indices) == root;
+}
+
+inline bool verify_merkle_multiproof(const merkle_multiproof& multiproof, std::span<const gindex_t> indices,
+                                     const chunk_t& root) {
+    return verify_merkle_multiproof(multiproof.leaves, multiproof.proof, indices, root);
+}
+}  // namespace ssz
@@ -0,0 +1,148 @@
+/*  pubkey_cache.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+#include "beacon_state.hpp"
+#include "merkleize.hpp"
+#include "thread_pool.hpp"
+
+namespace ssz {
+struct pubkey_root_t : ssz_container {
+    bls_pubkey_t pubkey;
+    Root root;
+
+    constexpr auto operator<=>(const pubkey_root_t& rhs) const noexcept = default;
+    constexpr bool operator==(const pubkey_root_t& rhs) const noexcept = default;
+
+    SSZ_CONT(pubkey, root);
+};
+
+/**
+ * \brief the hash tree roots of the validator pubkeys, by validator index, kept between hashes of the registry.
+ *
+ * A pubkey never changes once its validator is deposited, so its root is computed once and reused by every later
+ * hash_tree_root(result, validators, cache). An entry is only used if its pubkey matches the one of the validator at
+ * its index, otherwise it is recomputed. Only the pubkeys are cached, the other members of every validator are hashed
+ * again on each call. The cache is serialized as an ssz::list<pubkey_root_t, VALIDATOR_REGISTRY_LIMIT> so that it
+ * can be reloaded after a restart; the roots read back are trusted.
+ *
+ * The hash of a beacon_state_t does not use this cache: its validators are a cached_list that keeps the roots of the
+ * whole registry instead.
+ */
+struct pubkey_root_cache {
+    std::vector<pubkey_root_t> entries;
+
+    bool operator==(const pubkey_root_cache& rhs) const noexcept = default;
+
+    /**
+     * \brief writes at out + i * stride the root of get(i), the pubkey of the validator first + i, for i < count.
+     *
+     * The entries up to first + count have to exist. Different ranges of validators can be processed concurrently.
+     */
+    void pubkey_roots(std::byte* out, std::size_t stride, std::size_t first, std::size_t count, const auto& get) {
+        std::vector<std::size_t> misses{};
+        for (std::size_t i = 0; i < count; i++) {
+            const auto& entry = entries[first + i];
+            // no pubkey has a zero root, it marks the entries never computed
+            if (entry.root != Root{} && entry.pubkey == get(i))
+                std::ranges::copy(entry.root, out + i * stride);
+            else
+                misses.push_back(i);
+        }
+        if (misses.empty()) return;
+        std::vector<chunk_t> roots(misses.size());
+        _detail::batch_hash_tree_roots<bls_pubkey_t>(reinterpret_cast<std::byte*>(roots.data()), BYTES_PER_CHUNK,
+                                                     misses.size(),
+                                                     [&](std::size_t j) -> decltype(auto) { return get(misses[j]); });
+        for (std::size_t j = 0; j < misses.size(); j++) {
+            entries[first + misses[j]] = pubkey_root_t{.pubkey = get(misses[j]), .root = roots[j]};
+            std::ranges::copy(roots[j], out + misses[j] * stride);
+        }
+    }
+};
+
+// Serialization of the cache as a list of its entries
+inline auto serialize(const pubkey_root_cache& cache) { return serialize(cache.entries); }
+
+void deserialize(const serialized_range auto& bytes, pubkey_root_cache& cache) {
+    ssz::list<pubkey_root_t, VALIDATOR_REGISTRY_LIMIT> entries{};
+    deserialize(bytes, entries);
+    cache.entries = std::move(entries.data());
+}
+
+/**
+ * \brief hash_tree_root of a list of validators taking the roots of their pubkeys from cache.
+ *
+ * The cache is extended to the size of the list and filled with the roots it was missing. Batches of validators are
+ * hashed in parallel as with the other overloads.
+ */
+template <std::ranges::random_access_range R>
+    requires(std::is_same_v<std::ranges::range_value_t<R>, validator_t> && _detail::list_traits<R>::value)
+void hash_tree_root(ssz_iterator auto result, const R& validators, pubkey_root_cache& cache,
+                    std::size_t cpu_count = 0) {
+    using members_type = _detail::members_t<validator_t>;
+    constexpr auto member_count = std::tuple_size_v<members_type>;
+    constexpr auto width = std::bit_ceil(member_count);
+    auto rsize = static_cast<std::size_t>(std::ranges::size(validators));
+    auto first_validator = std::ranges::begin(validators);
+    if (cache.entries.size() < rsize) cache.entries.resize(rsize);
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+
+    _detail::scratch_buffer roots{rsize * BYTES_PER_CHUNK};
+    auto element_roots = [&](std::size_t first, std::size_t count) {
+        _detail::scratch_buffer leaves{count * width * BYTES_PER_CHUNK};
+        cache.pubkey_roots(leaves.data(), width * BYTES_PER_CHUNK, first, count,
+                           [&](std::size_t i) -> const auto& { return first_validator[first + i].pubkey; });
+        // the other members are hashed column by column as in batch_hash_tree_roots
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            (_detail::batch_hash_tree_roots<std::remove_cvref_t<std::tuple_element_t<I + 1, members_type>>>(
+                 leaves.data() + (I + 1) * BYTES_PER_CHUNK, width * BYTES_PER_CHUNK, count,
+                 [&](std::size_t i) -> decltype(auto) {
+                     return std::get<I + 1>(first_validator[first + i].ssz_members());
+                 }),
+             ...);
+        }(std::make_index_sequence<member_count - 1>{});
+        _detail::scratch_buffer scratch{leaves.size() / 2};
+        auto batch_roots = _detail::merkleize_batch(leaves.data(), scratch.data(), count, width);
+        std::copy_n(batch_roots, count * BYTES_PER_CHUNK, roots.data() + first * BYTES_PER_CHUNK);
+    };
+    {
+        task_group tasks{};
+        for (std::size_t first = 0; first < rsize; first += _detail::batch_hash_size) {
+            auto count = std::min(_detail::batch_hash_size, rsize - first);
+            if (cpu_count > 1 && first + count < rsize)
+                tasks.run([&element_roots, first, count] { element_roots(first, count); });
+            else
+                element_roots(first, count);
+        }
+        tasks.wait();
+    }
+    chunk_t data_root{};
+    _detail::merkleize_chunks(std::begin(data_root), roots.data(), roots.size(), _detail::list_traits<R>::limit);
+    mix_in_length(result, std::begin(data_root), rsize);
+}
+}  // namespace ssz
@@ -0,0 +1,138 @@
+/*  scratch.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace ssz {
+namespace _detail {
+/**
+ * \brief a per thread stack of memory blocks backing the temporary buffers of the hashing functions.
+ *
+ * Buffers are taken from the top of the stack and released in the reverse order, which is the natural order of the
+ * recursive hashing functions and of the tasks that a thread runs while waiting on a task_group. Blocks are kept
+ * between buffers up to the peak usage of the thread, so that hashing an object again does not allocate. A thread that
+ * is done with large hashes returns the memory with trim() or release().
+ */
+class scratch_arena {
+   private:
+    static constexpr std::size_t alignment{64};
+    static constexpr std::size_t min_block_size{1 << 16};
+
+    struct aligned_delete {
+        void operator()(std::byte* ptr) const noexcept { ::operator delete[](ptr, std::align_val_t{alignment}); }
+    };
+    struct block {
+        std::unique_ptr<std::byte[], aligned_delete> data;
+        std::size_t size;
+    };
+
+    std::vector<block> m_blocks{};
+    std::size_t m_current{};  // the block at the top of the stack
+    std::size_t m_used{};     // the bytes used in the current block
+
+   public:
+    struct mark {
+        std::size_t block;
+        std::size_t used;
+    };
+
+    static scratch_arena& local() noexcept {
+        static thread_local scratch_arena arena{};
+        return arena;
+    }
+
+    mark position() const noexcept { return {m_current, m_used}; }
+    void rewind(mark m) noexcept {
+        m_current = m.block;
+        m_used = m.used;
+    }
+
+    // frees the blocks past the first max_size bytes, only when no buffer is in use
+    void trim(std::size_t max_size) noexcept {
+        if (m_current != 0 || m_used != 0) return;
+        std::size_t kept{}, count{};
+        for (; count < m_blocks.size() && kept + m_blocks[count].size <= max_size; count++)
+            kept += m_blocks[count].size;
+        m_blocks.resize(count);
+    }
+    // returns all the blocks to the system, only when no buffer is in use
+    void release() noexcept { trim(0); }
+
+    // the bytes held by the arena
+    std::size_t reserved() const noexcept {
+        std::size_t ret{};
+        for (const auto& b : m_blocks) ret += b.size;
+        return ret;
+    }
+
+    std::byte* allocate(std::size_t size) {
+        size = (size + alignment - 1) / alignment * alignment;
+        for (; m_current < m_blocks.size(); m_current++, m_used = 0) {
+            if (m_blocks[m_current].size - m_used >= size) {
+                auto ret = m_blocks[m_current].data.get() + m_used;
+                m_used += size;
+                return ret;
+            }
+        }
+        // doubling the blocks keeps the number of allocations logarithmic in the peak usage
+        auto block_size = std::max({size, min_block_size, m_blocks.empty() ? 0 : 2 * m_blocks.back().size});
+        auto data = static_cast<std::byte*>(::operator new[](block_size, std::align_val_t{alignment}));
+        m_blocks.push_back({std::unique_ptr<std::byte[], aligned_delete>{data}, block_size});
+        m_current = m_blocks.size() - 1;
+        m_used = size;
+        return data;
+    }
+};
+
+/**
+ * \brief a zero initialized buffer of bytes taken from the calling thread's scratch_arena.
+ *
+ * It is released when it goes out of scope, buffers must be destroyed in the reverse order of their construction and
+ * on the thread that constructed them. Other threads may read and write to it while it is alive.
+ */
+class scratch_buffer {
+   private:
+    scratch_arena& m_arena;
+    scratch_arena::mark m_mark;
+    std::byte* m_data;
+    std::size_t m_size;
+
+   public:
+    explicit scratch_buffer(std::size_t size)
+        : m_arena{scratch_arena::local()}, m_mark{m_arena.position()}, m_data{m_arena.allocate(size)}, m_size{size} {
+        std::fill_n(m_data, m_size, std::byte{});
+    }
+    scratch_buffer(const scratch_buffer&) = delete;
+    scratch_buffer& operator=(const scratch_buffer&) = delete;
+    ~scratch_buffer() { m_arena.rewind(m_mark); }
+
+    std::byte* data() const noexcept { return m_data; }
+    std::size_t size() const noexcept { return m_size; }
+    std::byte* begin() const noexcept { return m_data; }
+    std::byte* end() const noexcept { return m_data + m_size; }
+};
+}  // namespace _detail
+}  // namespace ssz
@@ -0,0 +1,286 @@
+/*  serialized_hash.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "cached_tree.hpp"
+#include "container.hpp"
+#include "merkleize.hpp"
+
+namespace ssz {
+namespace _detail {
+/**
+ * \brief merkleizes a stream of chunks keeping a single pending node per height of the tree.
+ *
+ * Runs of consecutive chunks are hashed in blocks straight from the caller's buffer, so memory use does not depend on
+ * the number of chunks.
+ */
+class stream_merkleizer {
+   private:
+    static constexpr std::size_t max_height{64};
+    static constexpr std::size_t block_size{128};
+    std::array<chunk_t, max_height + 1> m_nodes;
+    std::bitset<max_height + 1> m_pending{};
+    std::uint64_t m_leaves{};
+
+    void add_node(std::size_t height, chunk_t node) {
+        for (; m_pending[height]; height++) {
+            hash_2_chunks(std::begin(node), m_nodes[height], node);
+            m_pending[height] = false;
+        }
+        m_nodes[height] = node;
+        m_pending[height] = true;
+    }
+
+    // adds count complete nodes at the given height, nothing is pending below that height
+    void add_nodes(std::size_t height, const std::byte* nodes, std::size_t count) {
+        auto take_one = [&]() {
+            chunk_t node;
+            std::copy_n(nodes, BYTES_PER_CHUNK, std::begin(node));
+            nodes += BYTES_PER_CHUNK;
+            count--;
+            add_node(height, node);
+        };
+        if (count > 0 && m_pending[height]) take_one();
+        std::array<chunk_t, block_size> parents;
+        while (count >= 2) {
+            auto pairs = std::min(count / 2, block_size);
+            hash(reinterpret_cast<std::byte*>(parents.data()), nodes, pairs);
+            add_nodes(height + 1, reinterpret_cast<const std::byte*>(parents.data()), pairs);
+            nodes += 2 * pairs * BYTES_PER_CHUNK;
+            count -= 2 * pairs;
+        }
+        if (count > 0) take_one();
+    }
+
+   public:
+    void add_chunk(const chunk_t& chunk) {
+        m_leaves++;
+        add_node(0, chunk);
+    }
+
+    void add_chunks(const std::byte* chunks, std::size_t count) {
+        m_leaves += count;
+        add_nodes(0, chunks, count);
+    }
+
+    // adds the chunks packing length bytes, the last one padded with zeros
+    void add_bytes(const std::byte* bytes, std::size_t length) {
+        add_chunks(bytes, length / BYTES_PER_CHUNK);
+        if (auto left_over = length % BYTES_PER_CHUNK) {
+            chunk_t last{};
+            std::copy_n(bytes + length - left_over, left_over, std::begin(last));
+            add_chunk(last);
+        }
+    }
+
+    // the root of the tree of the given depth with the chunks added so far as leaves, padded with zeros
+    chunk_t root(std::size_t depth) const {
+        if (m_leaves == 0) return zero_hash_array[depth];
+        if (depth < max_height && m_leaves > (std::uint64_t{1} << depth))
+            throw std::invalid_argument("more chunks than the limit");
+        if (m_pending[depth]) return m_nodes[depth];
+        chunk_t ret{};
+        bool started{false};
+        for (std::size_t height = 0; height < depth; height++) {
+            if (m_pending[height]) {
+                hash_2_chunks(std::begin(ret), m_nodes[height], started ? ret : zero_hash_array[height]);
+                started = true;
+            } else if (started) {
+                hash_2_chunks(std::begin(ret), ret, zero_hash_array[height]);
+            }
+        }
+        return ret;
+    }
+};
+
+inline std::uint32_t read_offset(std::span<const std::byte> bytes, std::size_t pos) {
+    if (pos + BYTES_PER_LENGTH_OFFSET > bytes.size()) throw std::invalid_argument("offset out of bounds");
+    std::uint32_t ret{};
+    deserialize(bytes.subspan(pos, BYTES_PER_LENGTH_OFFSET), ret);
+    return ret;
+}
+
+template <class T>
+chunk_t serialized_root(std::span<const std::byte> bytes);
+
+// adds to merkleizer the roots of the elements of type T serialized in bytes, returns the number of elements
+template <class T>
+std::size_t add_serialized_elements(stream_merkleizer& merkleizer, std::span<const std::byte> bytes) {
+    if constexpr (ssz_object_fixed_size<T>) {
+        constexpr auto size = static_size<T>();
+        if (bytes.size() % size != 0) throw std::invalid_argument("not a multiple of the element size");
+        auto count = bytes.size() / size;
+        if constexpr (std::is_same_v<T, Root>) {
+            merkleizer.add_chunks(bytes.data(), count);
+        } else {
+            for (std::size_t i = 0; i < count; i++)
+                merkleizer.add_chunk(serialized_root<T>(bytes.subspan(i * size, size)));
+        }
+        return count;
+    } else {
+        if (bytes.empty()) return 0;
+        auto offset = read_offset(bytes, 0);
+        if (offset % BYTES_PER_LENGTH_OFFSET != 0 || offset == 0 || offset > bytes.size())
+            throw std::invalid_argument("invalid first offset");
+        auto count = offset / BYTES_PER_LENGTH_OFFSET;
+        for (std::size_t i = 0; i < count; i++) {
+            auto next = (i + 1 < count) ? read_offset(bytes, (i + 1) * BYTES_PER_LENGTH_OFFSET) : bytes.size();
+            if (next < offset || next > bytes.size()) throw std::invalid_argument("offsets are not increasing");
+            merkleizer.add_chunk(serialized_root<T>(bytes.subspan(offset, next - offset)));
+            offset = next;
+        }
+        return count;
+    }
+}
+
+// the root of the members of the container of type T serialized in bytes
+template <class T>
+chunk_t serialized_container_root(std::span<const std::byte> bytes) {
+    constexpr auto member_count = std::tuple_size_v<members_t<T>>;
+    constexpr auto fixed_size = fixed_part_size<T>();
+    if (bytes.size() < fixed_size) throw std::invalid_argument("not enough serialized bytes");
+    if (ssz_object_fixed_size<T> && bytes.size() != fixed_size) throw std::invalid_argument("wrong serialized size");
+    std::array<chunk_t, member_count> roots;
+    std::array<std::size_t, member_count + 1> offsets{};
+    std::size_t variable_count{};
+    // fixed size members and the offsets of the variable size ones
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        std::size_t pos{};
+        auto visit = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            using member_type = member_t<T, J>;
+            if constexpr (ssz_object_variable_size<member_type>) {
+                offsets[variable_count++] = read_offset(bytes, pos);
+            } else {
+                roots[J] = serialized_root<member_type>(bytes.subspan(pos, static_size<member_type>()));
+            }
+            pos += placeholder_size<member_type>();
+        };
+        (visit(std::integral_constant<std::size_t, I>{}), ...);
+    }(std::make_index_sequence<member_count>{});
+    if (variable_count > 0) {
+        if (offsets[0] != fixed_size) throw std::invalid_argument("invalid first offset");
+        offsets[variable_count] = bytes.size();
+        for (std::size_t i = 0; i < variable_count; i++)
+            if (offsets[i + 1] < offsets[i]) throw std::invalid_argument("offsets are not increasing");
+    }
+    // variable size members
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+        std::size_t idx{};
+        auto visit = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+            using member_type = member_t<T, J>;
+            if constexpr (ssz_object_variable_size<member_type>) {
+                roots[J] = serialized_root<member_type>(bytes.subspan(offsets[idx], offsets[idx + 1] - offsets[idx]));
+                idx++;
+            }
+        };
+        (visit(std::integral_constant<std::size_t, I>{}), ...);
+    }(std::make_index_sequence<member_count>{});
+    stream_merkleizer merkleizer{};
+    merkleizer.add_chunks(reinterpret_cast<const std::byte*>(roots.data()), member_count);
+    return merkleizer.root(helpers::log2ceil(member_count));
+}
+
+/**
+ * \brief the hash tree root of the object of type T serialized in bytes, no object is constructed.
+ */
+template <class T>
+chunk_t serialized_root(std::span<const std::byte> bytes) {
+    stream_merkleizer merkleizer{};
+    chunk_t ret{};
+    if constexpr (basic_type<T>) {
+        if (bytes.size() != sizeof(T)) throw std::invalid_argument("wrong serialized size");
+        std::ranges::copy(bytes, std::begin(ret));
+    } else if constexpr (bitset_traits<T>::value) {
+        if (bytes.size() != static_size<T>()) throw std::invalid_argument("wrong serialized size");
+        merkleizer.add_bytes(bytes.data(), bytes.size());
+        ret = merkleizer.root(helpers::log2ceil((bytes.size() + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK));
+    } else if constexpr (bitlist_traits<T>::value) {
+        // the last set bit is the length delimiter
+        constexpr auto limit = bitlist_traits<T>::limit;
+        if (bytes.empty() || bytes.back() == std::byte{}) throw std::invalid_argument("missing bitlist delimiter");
+        auto last = std::to_integer<std::uint8_t>(bytes.back());
+        auto highest_bit = CHAR_BIT - std::countl_zero(last) - 1;
+        std::uint64_t length = (bytes.size() - 1) * CHAR_BIT + highest_bit;
+        if (length > limit) throw std::out_of_range("bitlist larger than its limit");
+        auto full_chunks = (bytes.size() - 1) / BYTES_PER_CHUNK;
+        merkleizer.add_chunks(bytes.data(), full_chunks);
+        chunk_t tail{};
+        std::ranges::copy(bytes.subspan(full_chunks * BYTES_PER_CHUNK), std::begin(tail));
+        tail[bytes.size() - 1 - full_chunks * BYTES_PER_CHUNK] &= ~(std::byte{1} << highest_bit);
+        if (length > full_chunks * BYTES_PER_CHUNK * CHAR_BIT) merkleizer.add_chunk(tail);
+        auto root = merkleizer.root(helpers::log2ceil((limit + CHAR_BIT * BYTES_PER_CHUNK - 1) /
+                                                      (CHAR_BIT * BYTES_PER_CHUNK)));
+        mix_in_length(std::begin(ret), std::begin(root), length);
+    } else if constexpr (list_traits<T>::value || vector_traits<T>::value) {
+        using traits = std::conditional_t<list_traits<T>::value, list_traits<T>, vector_traits<T>>;
+        using value_type = typename traits::value_type;
+        std::size_t count{};
+        std::size_t depth{};
+        if constexpr (basic_type<value_type>) {
+            if (bytes.size() % sizeof(value_type) != 0) throw std::invalid_argument("not a multiple of the basic size");
+            count = bytes.size() / sizeof(value_type);
+            merkleizer.add_bytes(bytes.data(), bytes.size());
+            depth = helpers::log2ceil((traits::limit * sizeof(value_type) + BYTES_PER_CHUNK - 1) / BYTES_PER_CHUNK);
+        } else {
+            count = add_serialized_elements<value_type>(merkleizer, bytes);
+            depth = helpers::log2ceil(traits::limit);
+        }
+        if (count > traits::limit) throw std::out_of_range("more elements than the limit");
+        if constexpr (list_traits<T>::value) {
+            auto root = merkleizer.root(depth);
+            mix_in_length(std::begin(ret), std::begin(root), count);
+        } else {
+            if (count != traits::limit) throw std::invalid_argument("wrong number of elements in vector");
+            ret = merkleizer.root(depth);
+        }
+    } else if constexpr (requires(const T& t) { t.ssz_members(); }) {
+        ret = serialized_container_root<T>(bytes);
+    } else {
+        static_assert(sizeof(T) == 0, "unsupported type");
+    }
+    return ret;
+}
+}  // namespace _detail
+
+/**
+ * \brief computes the hash tree root of an object of type T from its serialization.
+ *
+ * The byte layout is walked using the types of T, packed chunks are hashed straight from bytes. Nothing proportional
+ * to the size of the object is allocated. Throws std::invalid_argument or std::out_of_range on malformed input.
+ */
+template <ssz_object T>
+chunk_t hash_tree_root_serialized(const serialized_range auto& bytes) {
+    return _detail::serialized_root<T>(std::span<const std::byte>{std::ranges::data(bytes), std::ranges::size(bytes)});
+}
+
+template <ssz_object T>
+void hash_tree_root_serialized(ssz_iterator auto result, const serialized_range auto& bytes) {
+    std::ranges::copy(hash_tree_root_serialized<T>(bytes), result);
+}
+}  // namespace ssz
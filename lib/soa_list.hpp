@@ -0,0 +1,322 @@
+/*  soa_list.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#ifdef HAVE_YAML
+#include <yaml-cpp/yaml.h>
+#endif
+
+#include "beacon_state.hpp"
+#include "cached_tree.hpp"
+#include "container.hpp"
+#include "merkleize.hpp"
+#include "thread_pool.hpp"
+
+namespace ssz {
+namespace _detail {
+// booleans are stored as bytes so that their column can be viewed as a span
+template <class T>
+using soa_column_t = std::conditional_t<std::is_same_v<T, bool>, std::uint8_t, T>;
+
+template <class T, class Members = members_t<T>>
+struct soa_columns;
+
+template <class T, class... Members>
+struct soa_columns<T, std::tuple<Members...>> {
+    using type = std::tuple<std::vector<soa_column_t<std::remove_cvref_t<Members>>>...>;
+};
+
+// the index in SSZ_CONT of the member of T pointed to by Member
+template <class T, auto Member>
+consteval std::size_t member_pointer_index() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+        T t{};
+        auto members = t.ssz_members();
+        const void* addresses[] = {&std::get<I>(members)...};
+        return static_cast<std::size_t>(std::ranges::find(addresses, static_cast<const void*>(&(t.*Member))) -
+                                        std::ranges::begin(addresses));
+    }(std::make_index_sequence<std::tuple_size_v<members_t<T>>>{});
+}
+}  // namespace _detail
+
+/**
+ * \brief an SSZ list of at most N fixed size containers stored as a structure of arrays.
+ *
+ * Each member of T declared in SSZ_CONT is stored in its own column, so that scans over a few members of every element
+ * read contiguous memory, column<&T::member>() is a span over the values of that member. Serialization and
+ * hash_tree_root are those of ssz::list<T, N>; when hashing, each member is merkleized for a whole batch of elements
+ * at once.
+ *
+ * Elements are read with operator[], get() or iterators, which assemble a T, and written with set() or push_back().
+ * As in ssz::list, enable_root_cache() keeps the element roots and their tree between hashes, also used for proofs:
+ * set() and push_back() mark one element, resize(), deserialize() and the non-const column() mark all of them.
+ */
+template <ssz_fixed_size_container T, std::size_t N>
+class soa_list {
+   private:
+    static constexpr std::size_t member_count = std::tuple_size_v<_detail::members_t<T>>;
+    typename _detail::soa_columns<T>::type m_columns{};
+    std::size_t m_size{};
+    _detail::root_cache_ptr<_detail::element_root_cache<N>> m_roots{};
+
+    template <std::size_t I>
+    using member_t = _detail::member_t<T, I>;
+
+    template <std::size_t I>
+    decltype(auto) value(std::size_t pos) const {
+        if constexpr (std::is_same_v<member_t<I>, bool>)
+            return std::get<I>(m_columns)[pos] != 0;
+        else
+            return std::get<I>(m_columns)[pos];
+    }
+
+    void for_each_column(const auto& f) {
+        std::apply([&f](auto&... columns) { (f(columns), ...); }, m_columns);
+    }
+
+   public:
+    // iterates over the elements, assembling each of them
+    class const_iterator {
+       private:
+        const soa_list* m_list{};
+        std::size_t m_pos{};
+
+       public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        const_iterator() = default;
+        const_iterator(const soa_list* list, std::size_t pos) : m_list{list}, m_pos{pos} {}
+
+        T operator*() const { return m_list->get(m_pos); }
+        const_iterator& operator++() {
+            m_pos++;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            auto ret = *this;
+            m_pos++;
+            return ret;
+        }
+        bool operator==(const const_iterator& rhs) const noexcept { return m_pos == rhs.m_pos; }
+    };
+
+    soa_list() = default;
+    soa_list(const std::vector<T>& list) {
+        reserve(list.size());
+        for (const auto& elem : list) push_back(elem);
+    }
+
+    auto begin() const noexcept { return const_iterator{this, 0}; }
+    auto end() const noexcept { return const_iterator{this, m_size}; }
+    auto size() const noexcept { return m_size; }
+    bool empty() const noexcept { return m_size == 0; }
+    static constexpr auto limit() noexcept { return N; }
+
+    template <auto Member>
+    auto column() noexcept {
+        m_roots.mark_all_dirty();
+        return std::span{std::get<_detail::member_pointer_index<T, Member>()>(m_columns)};
+    }
+    template <auto Member>
+    auto column() const noexcept {
+        return std::span{std::get<_detail::member_pointer_index<T, Member>()>(m_columns)};
+    }
+
+    T get(std::size_t pos) const {
+        T ret{};
+        auto members = ret.ssz_members();
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((std::get<I>(members) = value<I>(pos)), ...);
+        }(std::make_index_sequence<member_count>{});
+        return ret;
+    }
+    T operator[](std::size_t pos) const { return get(pos); }
+
+    void set(std::size_t pos, const T& elem) {
+        m_roots.mark_dirty(pos);
+        auto members = elem.ssz_members();
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((std::get<I>(m_columns)[pos] = std::get<I>(members)), ...);
+        }(std::make_index_sequence<member_count>{});
+    }
+    void push_back(const T& elem) {
+        m_roots.mark_appended(m_size);
+        for_each_column([this](auto& column) { column.resize(m_size + 1); });
+        m_size++;
+        set(m_size - 1, elem);
+    }
+    void resize(std::size_t count) {
+        for_each_column([count](auto& column) { column.resize(count); });
+        m_size = count;
+        m_roots.mark_all_dirty();
+    }
+    void reserve(std::size_t count) {
+        for_each_column([count](auto& column) { column.reserve(count); });
+    }
+
+    /**
+     * \brief serializes in place the elements, returns the end of the bytes written.
+     */
+    auto serialize(ssz_iterator auto result) const {
+        constexpr auto element_size = T::ssz_fixed_part_size;
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            auto serialize_column = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+                for (std::size_t i = 0; i < m_size; i++)
+                    ssz::serialize(result + i * element_size + T::ssz_member_positions[J], value<J>(i));
+            };
+            (serialize_column(std::integral_constant<std::size_t, I>{}), ...);
+        }(std::make_index_sequence<member_count>{});
+        return result + m_size * element_size;
+    }
+
+    /**
+     * \brief deserializes the elements, throws std::invalid_argument if the bytes are not a list of T.
+     */
+    void deserialize(const serialized_range auto& bytes) {
+        constexpr auto element_size = T::ssz_fixed_part_size;
+        auto count = vector_length<T>(bytes);
+        if (count > N) throw std::invalid_argument("list exceeds its limit");
+        resize(count);
+        auto data = std::ranges::data(bytes);
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            auto deserialize_column = [&]<std::size_t J>(std::integral_constant<std::size_t, J>) {
+                constexpr auto member_size = _detail::static_size<member_t<J>>();
+                member_t<J> member{};
+                for (std::size_t i = 0; i < count; i++) {
+                    ssz::deserialize(
+                        std::span{data + i * element_size + T::ssz_member_positions[J], member_size}, member);
+                    std::get<J>(m_columns)[i] = member;
+                }
+            };
+            (deserialize_column(std::integral_constant<std::size_t, I>{}), ...);
+        }(std::make_index_sequence<member_count>{});
+    }
+
+    /**
+     * \brief writes the roots of the count elements from first, consecutively.
+     *
+     * The columns of each batch of batch_hash_size elements are the leaves of subtrees which are merkleized together,
+     * each member with a single pass over its column.
+     */
+    void element_roots(std::byte* out, std::size_t first, std::size_t count) const {
+        constexpr auto width = std::bit_ceil(member_count);
+        for (std::size_t done = 0; done < count; done += _detail::batch_hash_size) {
+            auto batch_size = std::min(_detail::batch_hash_size, count - done);
+            auto batch_first = first + done;
+            _detail::scratch_buffer leaves{batch_size * width * BYTES_PER_CHUNK};
+            [&]<std::size_t... I>(std::index_sequence<I...>) {
+                (_detail::batch_hash_tree_roots<member_t<I>>(
+                     leaves.data() + I * BYTES_PER_CHUNK, width * BYTES_PER_CHUNK, batch_size,
+                     [&](std::size_t i) -> decltype(auto) { return value<I>(batch_first + i); }),
+                 ...);
+            }(std::make_index_sequence<member_count>{});
+            _detail::scratch_buffer scratch{leaves.size() / 2};
+            auto roots = _detail::merkleize_batch(leaves.data(), scratch.data(), batch_size, width);
+            std::copy_n(roots, batch_size * BYTES_PER_CHUNK, out + done * BYTES_PER_CHUNK);
+        }
+    }
+
+    // keeps the element roots between hashes from the next hash on, requires exclusive access to the list
+    void enable_root_cache() noexcept { m_roots.enable(); }
+    // the element roots kept between hashes, or null without enable_root_cache()
+    auto root_cache() const { return m_roots.get(); }
+
+    struct variable_size : std::true_type {};
+    using value_type = T;
+    using size_type = std::size_t;
+
+    bool operator==(const soa_list& rhs) const = default;
+};
+
+namespace _detail {
+template <ssz_fixed_size_container T, std::size_t N>
+struct list_traits<soa_list<T, N>> : list_traits<list<T, N>> {};
+}  // namespace _detail
+
+template <ssz_fixed_size_container T, std::size_t N>
+auto serialize(ssz_iterator auto result, const soa_list<T, N>& r) {
+    return r.serialize(result);
+}
+
+template <ssz_fixed_size_container T, std::size_t N>
+auto serialize(const soa_list<T, N>& r) {
+    std::vector<std::byte> ret(r.size() * T::ssz_fixed_part_size);
+    r.serialize(ret.begin());
+    return ret;
+}
+
+template <ssz_fixed_size_container T, std::size_t N>
+void deserialize(const serialized_range auto& bytes, soa_list<T, N>& ret) {
+    ret.deserialize(bytes);
+}
+
+// hash_tree_root of lists stored as structures of arrays, batches of elements are hashed in parallel
+template <ssz_fixed_size_container T, std::size_t N>
+void hash_tree_root(ssz_iterator auto result, const soa_list<T, N>& r, size_t cpu_count = 0) {
+    auto rsize = r.size();
+    if (cpu_count == 0) cpu_count = thread_pool::global().concurrency();
+    auto write_roots = [&r](std::byte* out, auto first, auto count) { r.element_roots(out, first, count); };
+    if (auto cache = r.root_cache()) {
+        if (auto data_root = cache->root(rsize, cpu_count, write_roots)) {
+            mix_in_length(result, std::begin(*data_root), rsize);
+            return;
+        }
+    }
+    _detail::scratch_buffer roots{rsize * BYTES_PER_CHUNK};
+    _detail::batch_element_roots(roots.data(), rsize, cpu_count, write_roots);
+    chunk_t data_root{};
+    _detail::merkleize_chunks(std::begin(data_root), roots.data(), roots.size(), N);
+    mix_in_length(result, std::begin(data_root), rsize);
+}
+
+template <ssz_fixed_size_container T, std::size_t N>
+auto hash_tree_root(const soa_list<T, N>& r, size_t cpu_count = 0) {
+    chunk_t ret{};
+    hash_tree_root(std::begin(ret), r, cpu_count);
+    return ret;
+}
+
+// the validator registry stored column by column, serialized and hashed like the validators member of the state
+using validator_registry_t = soa_list<validator_t, VALIDATOR_REGISTRY_LIMIT>;
+}  // namespace ssz
+
+#ifdef HAVE_YAML
+template <ssz::ssz_fixed_size_container T, size_t N>
+struct YAML::convert<ssz::soa_list<T, N>> {
+    static bool decode(const YAML::Node& node, ssz::soa_list<T, N>& r) {
+        std::vector<T> elements{};
+        if (!YAML::convert<std::vector<T>>::decode(node, elements)) return false;
+        r = ssz::soa_list<T, N>{elements};
+        return true;
+    }
+};
+#endif
@@ -23,6 +23,12 @@
 #include <stdexcept>
 #include "bitlists.hpp"
 #include "container.hpp"
+#include "cached_tree.hpp"
+#include "persistent_list.hpp"
+#include "proofs.hpp"
+#include "serialized_hash.hpp"
+#include "soa_list.hpp"
+#include "view.hpp"
 
 namespace ssz {
 template <ssz_object T>
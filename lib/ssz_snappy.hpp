@@ -0,0 +1,413 @@
+/*  ssz_snappy.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#if !__has_include(<snappy.h>)
+#error "ssz_snappy.hpp requires the snappy library"
+#endif
+#include <snappy.h>
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "container.hpp"
+#include "stream.hpp"
+
+namespace ssz {
+// the largest block of uncompressed bytes in a chunk of the framing format, objects are compressed in such blocks
+constexpr std::size_t snappy_block_size{1 << 16};
+
+namespace _detail {
+consteval auto crc32c_table() {
+    std::array<std::uint32_t, 256> ret{};
+    for (std::uint32_t i = 0; i < 256; i++) {
+        auto crc = i;
+        for (int j = 0; j < 8; j++) crc = (crc & 1) ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+        ret[i] = crc;
+    }
+    return ret;
+}
+
+// the CRC-32C (Castagnoli) of bytes, masked as required by the snappy framing format
+inline std::uint32_t masked_crc32c(std::span<const std::byte> bytes) {
+    std::uint32_t crc{0xffffffff};
+#ifdef __SSE4_2__
+    std::uint64_t crc64{crc};
+    for (; bytes.size() >= sizeof(std::uint64_t); bytes = bytes.subspan(sizeof(std::uint64_t))) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes.data(), sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    for (auto b : bytes) crc = _mm_crc32_u8(crc, std::to_integer<std::uint8_t>(b));
+#else
+    static constexpr auto table = crc32c_table();
+    for (auto b : bytes) crc = table[(crc ^ std::to_integer<std::uint8_t>(b)) & 0xff] ^ (crc >> 8);
+#endif
+    crc = ~crc;
+    return ((crc >> 15) | (crc << 17)) + 0xa282ead8;
+}
+
+// every chunk of the framing format starts with its type and its length on three bytes, data chunks then have the
+// checksum of their uncompressed data
+constexpr std::size_t snappy_chunk_header_size{4};
+constexpr std::size_t snappy_checksum_size{4};
+
+constexpr std::array<std::byte, 10> snappy_stream_identifier{
+    std::byte{0xff}, std::byte{0x06}, std::byte{0x00}, std::byte{0x00}, std::byte{'s'},
+    std::byte{'N'},  std::byte{'a'},  std::byte{'P'},  std::byte{'p'},  std::byte{'Y'}};
+
+// reads the varint at the start of bytes into value, returns the number of bytes read or 0 if it is invalid
+inline std::size_t read_snappy_varint(std::span<const std::byte> bytes, std::uint32_t &value) {
+    value = 0;
+    for (std::size_t i = 0; i < std::min(bytes.size(), std::size_t{5}); i++) {
+        auto b = std::to_integer<std::uint32_t>(bytes[i]);
+        if (i == 4 && b > 0x0f) return 0;
+        value |= (b & 0x7f) << (7 * i);
+        if ((b & 0x80) == 0) return i + 1;
+    }
+    return 0;
+}
+
+/**
+ * \brief decodes the elements of a raw snappy block, passing the output to a byte sink by pieces of about
+ * snappy_block_size bytes.
+ *
+ * Only the last snappy_block_size bytes of output are kept as history for the copies, which is as far back as the
+ * copies emitted by snappy compressors reach since they compress by blocks of that size. Returns false, after having
+ * passed part of the output to the sink, if a valid copy reaches further back. Throws std::invalid_argument on
+ * invalid data.
+ */
+template <byte_sink ByteSink>
+bool snappy_window_decode(std::span<const std::byte> elements, std::size_t length, ByteSink &sink) {
+    constexpr std::size_t window = snappy_block_size;
+    constexpr std::size_t max_copy = 64;
+    std::vector<std::byte> buffer(2 * window);
+    std::size_t end{}, fed{}, total{};
+    // passes the pending output to the sink and keeps the history needed by the copies
+    auto reserve = [&](std::size_t count) {
+        if (end + count <= buffer.size()) return;
+        sink(std::span<const std::byte>{buffer}.subspan(fed, end - fed));
+        auto keep = std::min(end, window);
+        std::copy(buffer.begin() + (end - keep), buffer.begin() + end, buffer.begin());
+        end = fed = keep;
+    };
+    auto take = [&elements](std::size_t count) {
+        if (elements.size() < count) throw std::invalid_argument("truncated snappy data");
+        auto ret = elements.first(count);
+        elements = elements.subspan(count);
+        return ret;
+    };
+    auto little_endian = [](std::span<const std::byte> bytes) {
+        std::size_t ret{};
+        for (std::size_t i = 0; i < bytes.size(); i++) ret |= std::to_integer<std::size_t>(bytes[i]) << (8 * i);
+        return ret;
+    };
+    while (!elements.empty()) {
+        auto tag = std::to_integer<std::size_t>(take(1)[0]);
+        std::size_t count{}, offset{};
+        if ((tag & 3) == 0) {
+            count = (tag >> 2) + 1;
+            if (count > 60) count = little_endian(take(count - 60)) + 1;
+            if (count > length - total) throw std::invalid_argument("snappy data longer than its length");
+            auto literal = take(count);
+            while (!literal.empty()) {
+                reserve(std::min(literal.size(), window));
+                auto piece = std::min(literal.size(), buffer.size() - end);
+                std::ranges::copy(literal.first(piece), buffer.begin() + end);
+                end += piece;
+                literal = literal.subspan(piece);
+            }
+            total += count;
+            continue;
+        }
+        if ((tag & 3) == 1) {
+            count = ((tag >> 2) & 7) + 4;
+            offset = (tag >> 5) << 8 | little_endian(take(1));
+        } else {
+            count = (tag >> 2) + 1;
+            offset = little_endian(take((tag & 3) == 2 ? 2 : 4));
+        }
+        if (offset == 0 || offset > total || count > length - total) throw std::invalid_argument("invalid snappy copy");
+        reserve(max_copy);
+        if (offset > end) return false;
+        // copies may overlap their own output, they are done byte by byte
+        for (std::size_t i = 0; i < count; i++, end++) buffer[end] = buffer[end - offset];
+        total += count;
+    }
+    if (total != length) throw std::invalid_argument("snappy data shorter than its length");
+    sink(std::span<const std::byte>{buffer}.subspan(fed, end - fed));
+    return true;
+}
+
+// compresses a block of at most snappy_block_size bytes into out, returns the compressed size
+inline std::size_t compress_block(std::span<const std::byte> block, std::byte *out) {
+    std::size_t ret{};
+    snappy::RawCompress(reinterpret_cast<const char *>(block.data()), block.size(), reinterpret_cast<char *>(out),
+                        &ret);
+    return ret;
+}
+}  // namespace _detail
+
+/**
+ * \brief deserializes a container from its snappy compressed serialization in the raw block format.
+ *
+ * The block is decompressed by pieces that are fed to a stream_decoder, with a window of snappy_block_size bytes of
+ * history, instead of into a contiguous buffer of the whole serialization. Data with copies reaching further back,
+ * which snappy compressors do not produce, is decompressed whole and then deserialized. Throws
+ * std::invalid_argument on invalid compressed data.
+ */
+template <ssz_object T>
+    requires std::derived_from<T, ssz_container>
+void deserialize_snappy(std::span<const std::byte> compressed, T &ret) {
+    std::uint32_t size{};
+    auto varint_size = _detail::read_snappy_varint(compressed, size);
+    if (varint_size == 0) throw std::invalid_argument("invalid snappy data");
+    {
+        stream_decoder<T> decoder{ret, size};
+        auto feed = [&](std::span<const std::byte> chunk) { decoder.feed(chunk); };
+        if (_detail::snappy_window_decode(compressed.subspan(varint_size), size, feed)) {
+            if (!decoder.done()) throw std::invalid_argument("invalid snappy data");
+            return;
+        }
+    }
+    std::vector<std::byte> bytes(size);
+    if (!snappy::RawUncompress(reinterpret_cast<const char *>(compressed.data()), compressed.size(),
+                               reinterpret_cast<char *>(bytes.data())))
+        throw std::invalid_argument("invalid snappy data");
+    deserialize(bytes, ret);
+}
+
+/**
+ * \brief serializes r and compresses it in the snappy raw block format, passing the compressed bytes to sink.
+ *
+ * The object is serialized and compressed by blocks of snappy_block_size bytes, which is what snappy does with a
+ * contiguous input, so that only one block is held at a time.
+ */
+template <ssz_object T, byte_sink Sink>
+void serialize_snappy(Sink &&sink, const T &r) {
+    auto size = ssz::size(r);
+    if (size > std::numeric_limits<std::uint32_t>::max()) throw std::invalid_argument("object too large for snappy");
+    // the uncompressed length as a varint
+    std::array<std::byte, 5> length{};
+    std::size_t length_size{};
+    for (; size >= 0x80; size >>= 7) length[length_size++] = std::byte{static_cast<std::uint8_t>(size | 0x80)};
+    length[length_size++] = std::byte{static_cast<std::uint8_t>(size)};
+    sink(std::span<const std::byte>{length}.first(length_size));
+
+    std::vector<std::byte> compressed(snappy::MaxCompressedLength(snappy_block_size));
+    serialize_to(
+        [&](std::span<const std::byte> block) {
+            auto compressed_size = _detail::compress_block(block, compressed.data());
+            // every block starts with its own length, only the length of the whole object is kept
+            std::size_t skip{};
+            while ((compressed[skip++] & std::byte{0x80}) != std::byte{}) {}
+            sink(std::span<const std::byte>{compressed}.subspan(skip, compressed_size - skip));
+        },
+        r, snappy_block_size);
+}
+
+template <ssz_object T>
+std::vector<std::byte> serialize_snappy(const T &r) {
+    std::vector<std::byte> ret{};
+    serialize_snappy([&](std::span<const std::byte> chunk) { ret.insert(ret.end(), chunk.begin(), chunk.end()); }, r);
+    return ret;
+}
+
+/**
+ * \brief a resumable decoder of the snappy framing format that passes the decompressed bytes to a sink.
+ *
+ * Compressed bytes are pushed in order with feed(), chunks are checked against their CRC-32C and decompressed as soon
+ * as they are complete. At most one chunk is staged. Throws std::invalid_argument on invalid data.
+ */
+template <byte_sink Sink>
+class snappy_frame_decoder {
+   private:
+    static constexpr auto header_size = _detail::snappy_chunk_header_size;
+    static constexpr auto checksum_size = _detail::snappy_checksum_size;
+
+    Sink &m_sink;
+    std::array<std::byte, header_size> m_header{};
+    std::size_t m_header_used{};
+    std::vector<std::byte> m_body{};
+    std::vector<std::byte> m_block{};
+    std::size_t m_skip{};
+    bool m_started{};
+
+    std::uint8_t chunk_type() const { return std::to_integer<std::uint8_t>(m_header[0]); }
+    std::size_t chunk_length() const {
+        return std::to_integer<std::size_t>(m_header[1]) | std::to_integer<std::size_t>(m_header[2]) << 8 |
+               std::to_integer<std::size_t>(m_header[3]) << 16;
+    }
+
+    // checks the header of a chunk, skippable chunks are dropped without being staged
+    void start_chunk() {
+        auto type = chunk_type();
+        auto length = chunk_length();
+        if (type >= 0x80 && type != 0xff) {
+            m_skip = length;
+            m_header_used = 0;
+        } else if (type == 0xff) {
+            if (length != _detail::snappy_stream_identifier.size() - header_size)
+                throw std::invalid_argument("invalid snappy stream identifier");
+        } else if (type > 0x01) {
+            throw std::invalid_argument("unskippable reserved snappy chunk");
+        } else if (!m_started) {
+            throw std::invalid_argument("missing snappy stream identifier");
+        } else if (length < checksum_size ||
+                   length > checksum_size + (type == 0x00 ? snappy::MaxCompressedLength(snappy_block_size)
+                                                          : snappy_block_size)) {
+            throw std::invalid_argument("invalid snappy chunk length");
+        }
+    }
+
+    void process_chunk(std::span<const std::byte> body) {
+        if (chunk_type() == 0xff) {
+            if (!std::ranges::equal(body, std::span{_detail::snappy_stream_identifier}.subspan(header_size)))
+                throw std::invalid_argument("invalid snappy stream identifier");
+            m_started = true;
+            return;
+        }
+        std::uint32_t crc{};
+        deserialize(body.first(checksum_size), crc);
+        auto data = body.subspan(checksum_size);
+        if (chunk_type() == 0x00) {
+            auto compressed = reinterpret_cast<const char *>(data.data());
+            std::size_t size{};
+            if (!snappy::GetUncompressedLength(compressed, data.size(), &size) || size > snappy_block_size)
+                throw std::invalid_argument("invalid snappy chunk");
+            m_block.resize(snappy_block_size);
+            if (!snappy::RawUncompress(compressed, data.size(), reinterpret_cast<char *>(m_block.data())))
+                throw std::invalid_argument("invalid snappy chunk");
+            data = std::span<const std::byte>{m_block}.first(size);
+        }
+        if (_detail::masked_crc32c(data) != crc) throw std::invalid_argument("wrong snappy chunk checksum");
+        m_sink(data);
+    }
+
+   public:
+    explicit snappy_frame_decoder(Sink &sink) : m_sink{sink} {}
+
+    void feed(std::span<const std::byte> bytes) {
+        while (!bytes.empty()) {
+            if (m_skip > 0) {
+                auto count = std::min(m_skip, bytes.size());
+                m_skip -= count;
+                bytes = bytes.subspan(count);
+                continue;
+            }
+            if (m_header_used < header_size) {
+                auto count = std::min(header_size - m_header_used, bytes.size());
+                std::ranges::copy(bytes.first(count), m_header.begin() + m_header_used);
+                m_header_used += count;
+                bytes = bytes.subspan(count);
+                if (m_header_used == header_size) start_chunk();
+                continue;
+            }
+            auto length = chunk_length();
+            // whole chunks are decoded in place
+            if (m_body.empty() && bytes.size() >= length) {
+                process_chunk(bytes.first(length));
+                bytes = bytes.subspan(length);
+                m_header_used = 0;
+                continue;
+            }
+            auto count = std::min(length - m_body.size(), bytes.size());
+            m_body.insert(m_body.end(), bytes.begin(), bytes.begin() + count);
+            bytes = bytes.subspan(count);
+            if (m_body.size() == length) {
+                process_chunk(m_body);
+                m_body.clear();
+                m_header_used = 0;
+            }
+        }
+    }
+
+    // signals the end of the input, throws if it ended in the middle of a chunk
+    void finish() const {
+        if (!m_started || m_header_used > 0 || m_skip > 0) throw std::invalid_argument("truncated snappy stream");
+    }
+};
+
+/**
+ * \brief serializes r and compresses it in the snappy framing format, passing the compressed bytes to sink.
+ *
+ * Every block of snappy_block_size serialized bytes is compressed as soon as it is produced, blocks that do not
+ * compress are written uncompressed.
+ */
+template <ssz_object T, byte_sink Sink>
+void serialize_snappy_framed(Sink &&sink, const T &r) {
+    constexpr auto header_size = _detail::snappy_chunk_header_size + _detail::snappy_checksum_size;
+    sink(std::span<const std::byte>{_detail::snappy_stream_identifier});
+    std::vector<std::byte> chunk(header_size + snappy::MaxCompressedLength(snappy_block_size));
+    serialize_to(
+        [&](std::span<const std::byte> block) {
+            auto compressed_size = _detail::compress_block(block, chunk.data() + header_size);
+            auto compressed = compressed_size < block.size();
+            auto length = _detail::snappy_checksum_size + (compressed ? compressed_size : block.size());
+            chunk[0] = compressed ? std::byte{0x00} : std::byte{0x01};
+            for (std::size_t i = 1; i < _detail::snappy_chunk_header_size; i++, length >>= 8)
+                chunk[i] = std::byte{static_cast<std::uint8_t>(length)};
+            serialize(chunk.begin() + _detail::snappy_chunk_header_size, _detail::masked_crc32c(block));
+            if (compressed) {
+                sink(std::span<const std::byte>{chunk}.first(header_size + compressed_size));
+            } else {
+                sink(std::span<const std::byte>{chunk}.first(header_size));
+                sink(block);
+            }
+        },
+        r, snappy_block_size);
+}
+
+template <ssz_object T>
+std::vector<std::byte> serialize_snappy_framed(const T &r) {
+    std::vector<std::byte> ret{};
+    auto append = [&](std::span<const std::byte> chunk) { ret.insert(ret.end(), chunk.begin(), chunk.end()); };
+    serialize_snappy_framed(append, r);
+    return ret;
+}
+
+/**
+ * \brief deserializes a container from its snappy compressed serialization in the framing format.
+ *
+ * Chunks are decompressed one at a time straight into a stream_decoder. Throws std::invalid_argument on invalid data.
+ */
+template <ssz_object T>
+    requires std::derived_from<T, ssz_container>
+void deserialize_snappy_framed(std::span<const std::byte> compressed, T &ret) {
+    stream_decoder<T> decoder{ret};
+    auto feed = [&](std::span<const std::byte> chunk) { decoder.feed(chunk); };
+    snappy_frame_decoder frames{feed};
+    frames.feed(compressed);
+    frames.finish();
+    decoder.finish();
+}
+}  // namespace ssz
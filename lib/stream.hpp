@@ -0,0 +1,423 @@
+/*  stream.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "concepts.hpp"
+#include "container.hpp"
+
+namespace ssz {
+// the default size of the chunks passed to a sink
+constexpr std::size_t default_stream_chunk_size{1 << 20};
+
+/**
+ * \brief a sink receives the serialization of an object as a sequence of chunks of bytes.
+ *
+ * The chunks are only valid for the duration of the call, they may point into the object being serialized.
+ */
+template <class S>
+concept byte_sink = std::invocable<S &, std::span<const std::byte>>;
+
+/**
+ * \brief a sink writing to a file descriptor such as a file, a pipe or a socket.
+ *
+ * Short writes are retried, throws std::system_error when the descriptor cannot be written to.
+ */
+struct fd_sink {
+    int fd;
+
+    void operator()(std::span<const std::byte> chunk) const {
+        while (!chunk.empty()) {
+            auto written = ::write(fd, chunk.data(), chunk.size());
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "could not write serialized bytes");
+            }
+            chunk = chunk.subspan(static_cast<std::size_t>(written));
+        }
+    }
+};
+
+/**
+ * \brief a sink writing to an output stream, throws std::ios_base::failure when the stream fails.
+ */
+struct ostream_sink {
+    std::ostream &os;
+
+    void operator()(std::span<const std::byte> chunk) const {
+        os.write(reinterpret_cast<const char *>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        if (!os) throw std::ios_base::failure("could not write serialized bytes");
+    }
+};
+
+namespace _detail {
+/**
+ * \brief serializes objects in order into a bounded buffer that is handed to a sink whenever it fills up.
+ *
+ * Objects that fit in the buffer are serialized in place with the usual functions. Larger containers and lists are
+ * split into their members and elements, with offsets computed from the sizes of the variable size parts, and
+ * contiguous ranges of packed elements are passed to the sink straight from memory.
+ */
+template <byte_sink Sink>
+class stream_serializer {
+   private:
+    Sink &m_sink;
+    std::vector<std::byte> m_buffer;
+    std::size_t m_used{};
+
+    void put(std::span<const std::byte> bytes) {
+        if (bytes.size() <= m_buffer.size()) {
+            if (bytes.size() > m_buffer.size() - m_used) flush();
+            std::ranges::copy(bytes, m_buffer.begin() + m_used);
+            m_used += bytes.size();
+            return;
+        }
+        flush();
+        for (std::size_t pos = 0; pos < bytes.size(); pos += m_buffer.size())
+            m_sink(bytes.subspan(pos, std::min(m_buffer.size(), bytes.size() - pos)));
+    }
+
+    void write_offset(std::size_t offset) {
+        std::array<std::byte, BYTES_PER_LENGTH_OFFSET> bytes{};
+        serialize(bytes.begin(), static_cast<std::uint32_t>(offset));
+        put(bytes);
+    }
+
+    template <class T>
+    static std::size_t serialized_size(const T &r) {
+        if constexpr (ssz_object_fixed_size<T>)
+            return static_size<T>();
+        else
+            return ssz::size(r);
+    }
+
+    // the sizes of the variable size members are computed once, for their offsets and for writing them
+    template <class T>
+    void write_members(const T &r) {
+        auto members = r.ssz_members();
+        std::apply(
+            [&](const auto &...member) {
+                const std::array<std::size_t, sizeof...(member)> sizes{serialized_size(member)...};
+                std::size_t offset = fixed_part_size<T>();
+                auto write_fixed = [&, idx = std::size_t{}](const auto &m) mutable {
+                    if constexpr (ssz_object_fixed_size<decltype(m)>) {
+                        write(m, sizes[idx]);
+                    } else {
+                        write_offset(offset);
+                        offset += sizes[idx];
+                    }
+                    idx++;
+                };
+                auto write_variable = [&, idx = std::size_t{}](const auto &m) mutable {
+                    if constexpr (ssz_object_variable_size<decltype(m)>) write(m, sizes[idx]);
+                    idx++;
+                };
+                (write_fixed(member), ...);
+                (write_variable(member), ...);
+            },
+            members);
+    }
+
+    template <class R>
+    void write_elements(const R &r) {
+        using value_type = std::ranges::range_value_t<R>;
+        if constexpr (packed_layout<value_type> && std::ranges::contiguous_range<R>) {
+            put({static_cast<const std::byte *>(static_cast<const void *>(std::ranges::data(r))),
+                 std::ranges::size(r) * sizeof(value_type)});
+        } else if constexpr (ssz_object_fixed_size<value_type>) {
+            for (const auto &v : r) write(v, static_size<value_type>());
+        } else {
+            std::vector<std::size_t> sizes{};
+            sizes.reserve(std::ranges::size(r));
+            std::size_t offset = std::ranges::size(r) * BYTES_PER_LENGTH_OFFSET;
+            for (const auto &v : r) {
+                write_offset(offset);
+                sizes.push_back(ssz::size(v));
+                offset += sizes.back();
+            }
+            auto size = sizes.begin();
+            for (const auto &v : r) write(v, *size++);
+        }
+    }
+
+    // writes r whose serialized size is size
+    template <ssz_object T>
+    void write(const T &r, std::size_t size) {
+        if (size <= m_buffer.size()) {
+            if (size > m_buffer.size() - m_used) flush();
+            // some objects, like bitlists, are serialized on top of zeroed bytes
+            auto out = m_buffer.begin() + m_used;
+            std::fill_n(out, size, std::byte{});
+            serialize(out, r);
+            m_used += size;
+        } else if constexpr (requires { r.ssz_members(); }) {
+            write_members(r);
+        } else if constexpr (requires { requires !std::is_same_v<std::ranges::range_value_t<T>, bool>; }) {
+            write_elements(r);
+        } else {
+            // bitlists and bitvectors larger than a chunk
+            put(ssz::serialize(r));
+        }
+    }
+
+   public:
+    stream_serializer(Sink &sink, std::size_t chunk_size)
+        : m_sink{sink}, m_buffer(std::max(chunk_size, std::size_t{1})) {}
+
+    template <ssz_object T>
+    void write(const T &r) {
+        write(r, serialized_size(r));
+    }
+
+    void flush() {
+        if (m_used == 0) return;
+        m_sink(std::span<const std::byte>{m_buffer.data(), m_used});
+        m_used = 0;
+    }
+};
+}  // namespace _detail
+
+/**
+ * \brief serializes r by passing its bytes in order to sink, in chunks of at most chunk_size bytes.
+ *
+ * At most one chunk is buffered, so the memory used does not depend on the size of r. The bytes passed to the sink
+ * are those of serialize(r).
+ */
+template <ssz_object T, byte_sink Sink>
+void serialize_to(Sink &&sink, const T &r, std::size_t chunk_size = default_stream_chunk_size) {
+    _detail::stream_serializer<std::remove_reference_t<Sink>> serializer{sink, chunk_size};
+    serializer.write(r);
+    serializer.flush();
+}
+namespace _detail {
+// the indices of the variable size members of a container
+template <class T>
+consteval auto variable_member_indices() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+        std::array<std::size_t, (std::size_t{} + ... + ssz_object_variable_size<member_t<T, I>>)> ret{};
+        std::size_t idx{};
+        ((ssz_object_variable_size<member_t<T, I>> ? (ret[idx++] = I) : 0), ...);
+        return ret;
+    }(std::make_index_sequence<std::tuple_size_v<members_t<T>>>{});
+}
+
+// lists of fixed size elements are decoded element by element as their bytes arrive
+template <class M>
+concept streamed_list = list_traits<M>::value && ssz_object_fixed_size<typename list_traits<M>::value_type> &&
+                        requires(M &m) { m.data().resize(0); };
+}  // namespace _detail
+
+/**
+ * \brief a resumable decoder of a container declared with SSZ_CONT whose bytes arrive in chunks.
+ *
+ * Chunks are pushed in order with feed(). Every member is decoded as soon as its last byte arrives, the members of the
+ * fixed part and the variable size ones being staged until then, except lists of fixed size elements that are decoded
+ * element by element so that they are never staged. The last variable size member is not delimited by an offset: it is
+ * complete when the size passed to the constructor has been fed, or when finish() is called at the end of the input.
+ * Throws std::invalid_argument on inconsistent offsets or sizes, the object is then left partially decoded.
+ */
+template <ssz_object T>
+    requires std::derived_from<T, ssz_container>
+class stream_decoder {
+   public:
+    static constexpr std::size_t unknown_size{std::numeric_limits<std::size_t>::max()};
+
+   private:
+    static constexpr auto positions = _detail::member_positions<_detail::members_t<T>>();
+    static constexpr auto member_count = positions.size() - 1;
+    static constexpr auto fixed_size = positions.back();
+    static constexpr auto variable_members = _detail::variable_member_indices<T>();
+
+    T &m_ret;
+    std::size_t m_size;
+    std::size_t m_position{};
+    std::size_t m_member{};   // the member, or offset, being read in the fixed part
+    std::size_t m_current{};  // the variable size member being decoded after the fixed part
+    std::array<std::uint32_t, variable_members.size()> m_offsets{};
+    std::vector<std::byte> m_pending{};
+    bool m_done{};
+
+    // calls f with the i-th member
+    void visit_member(std::size_t i, auto &&f) {
+        auto members = m_ret.ssz_members();
+        [&]<std::size_t... J>(std::index_sequence<J...>) {
+            ((J == i ? f(std::get<J>(members)) : void()), ...);
+        }(std::make_index_sequence<member_count>{});
+    }
+
+    std::size_t member_end(std::size_t i) const { return i + 1 < m_offsets.size() ? m_offsets[i + 1] : m_size; }
+
+    // decodes the fixed size member, or reads the offset, staged in m_pending
+    void complete_fixed_member() {
+        visit_member(m_member, [&]<class M>(M &member) {
+            if constexpr (ssz_object_fixed_size<M>) {
+                deserialize(m_pending, member);
+            } else {
+                auto variable = std::ranges::find(variable_members, m_member) - variable_members.begin();
+                deserialize(m_pending, m_offsets[variable]);
+            }
+        });
+        m_pending.clear();
+        if (++m_member < member_count) return;
+        if constexpr (variable_members.empty()) {
+            m_done = true;
+            m_pending = {};
+        } else {
+            if (m_offsets.front() != fixed_size) throw std::invalid_argument("invalid first offset");
+            if (!std::ranges::is_sorted(m_offsets) || (m_size != unknown_size && m_offsets.back() > m_size))
+                throw std::invalid_argument("invalid member offset");
+            start_member();
+        }
+    }
+
+    void start_member() {
+        visit_member(variable_members[m_current], [&]<class M>(M &member) {
+            if constexpr (_detail::streamed_list<M>) member.data().clear();
+        });
+    }
+
+    template <class M>
+    void append_elements(M &member, std::span<const std::byte> bytes) {
+        using value_type = typename _detail::list_traits<M>::value_type;
+        constexpr auto element_size = _detail::static_size<value_type>();
+        auto &elements = member.data();
+        auto count = bytes.size() / element_size;
+        if (elements.size() + count > _detail::list_traits<M>::limit)
+            throw std::invalid_argument("list larger than its limit");
+        auto old_size = elements.size();
+        elements.resize(old_size + count);
+        if constexpr (packed_layout<value_type>) {
+            std::ranges::copy(bytes, static_cast<std::byte *>(static_cast<void *>(elements.data() + old_size)));
+        } else {
+            for (std::size_t i = 0; i < count; i++)
+                deserialize(bytes.subspan(i * element_size, element_size), elements[old_size + i]);
+        }
+    }
+
+    void consume(std::span<const std::byte> bytes) {
+        visit_member(variable_members[m_current], [&]<class M>(M &member) {
+            if constexpr (_detail::streamed_list<M>) {
+                constexpr auto element_size = _detail::static_size<typename _detail::list_traits<M>::value_type>();
+                // an element split between chunks is completed first
+                if (!m_pending.empty()) {
+                    auto missing = std::min(element_size - m_pending.size(), bytes.size());
+                    m_pending.insert(m_pending.end(), bytes.begin(), bytes.begin() + missing);
+                    bytes = bytes.subspan(missing);
+                    if (m_pending.size() < element_size) return;
+                    append_elements(member, m_pending);
+                    m_pending.clear();
+                }
+                auto whole = bytes.size() / element_size * element_size;
+                append_elements(member, bytes.first(whole));
+                m_pending.assign(bytes.begin() + whole, bytes.end());
+            } else {
+                m_pending.insert(m_pending.end(), bytes.begin(), bytes.end());
+            }
+        });
+    }
+
+    void complete_member() {
+        visit_member(variable_members[m_current], [&]<class M>(M &member) {
+            if constexpr (_detail::streamed_list<M>) {
+                if (!m_pending.empty()) throw std::invalid_argument("not a multiple of the element size");
+            } else {
+                deserialize(m_pending, member);
+                m_pending.clear();
+            }
+        });
+        if (++m_current < variable_members.size()) {
+            start_member();
+        } else {
+            m_done = true;
+            m_pending = {};
+        }
+    }
+
+   public:
+    // size is the total number of serialized bytes when known, eg from a length prefix
+    explicit stream_decoder(T &ret, std::size_t size = unknown_size) : m_ret{ret}, m_size{size} {
+        if (m_size != unknown_size && m_size < fixed_size) throw std::invalid_argument("not enough serialized bytes");
+    }
+
+    /**
+     * \brief decodes the next chunk of bytes, returns true when the object is completely decoded.
+     */
+    bool feed(std::span<const std::byte> chunk) {
+        if (chunk.size() > (m_done ? 0 : m_size - m_position))
+            throw std::invalid_argument("bytes past the end of the object");
+        // the fixed part, every member is staged until complete
+        while (m_member < member_count) {
+            auto end = positions[m_member + 1];
+            if (m_position == end) {
+                complete_fixed_member();
+                continue;
+            }
+            if (chunk.empty()) return false;
+            auto count = std::min(chunk.size(), end - m_position);
+            m_pending.insert(m_pending.end(), chunk.begin(), chunk.begin() + count);
+            m_position += count;
+            chunk = chunk.subspan(count);
+        }
+        // the variable size members, delimited by the offsets
+        while (!m_done) {
+            auto end = member_end(m_current);
+            if (m_position == end) {
+                complete_member();
+                continue;
+            }
+            if (chunk.empty()) break;
+            auto count = std::min(chunk.size(), end - m_position);
+            consume(chunk.first(count));
+            m_position += count;
+            chunk = chunk.subspan(count);
+        }
+        if (!chunk.empty()) throw std::invalid_argument("bytes past the end of the object");
+        return m_done;
+    }
+
+    /**
+     * \brief signals the end of the input, completing the last member. Throws if the object is not complete.
+     */
+    void finish() {
+        if (m_done) return;
+        if (m_member < member_count || m_size != unknown_size || m_current + 1 != variable_members.size())
+            throw std::invalid_argument("not enough serialized bytes");
+        complete_member();
+    }
+
+    bool done() const noexcept { return m_done; }
+};
+}  // namespace ssz
@@ -0,0 +1,261 @@
+/*  thread_pool.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ssz {
+/**
+ * \brief a persistent work-stealing thread pool used by all the parallel algorithms of the library.
+ *
+ * Each worker owns a deque of tasks, it pops its own tasks in LIFO order and steals from the others in FIFO order.
+ * Tasks submitted from outside the pool go to a shared queue. Threads waiting on a task_group execute pending tasks
+ * instead of blocking, so tasks can be nested arbitrarily without exhausting the workers.
+ */
+class thread_pool {
+   private:
+    using task_t = std::function<void()>;
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> m_queues;
+    worker_queue m_shared{};
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<std::size_t> m_queued{0};
+    // task_groups currently bound to this pool
+    std::atomic<std::size_t> m_groups{0};
+    bool m_stop{false};
+
+    static inline thread_local thread_pool* tl_pool{nullptr};
+    static inline thread_local std::size_t tl_index{0};
+
+    static std::optional<task_t> pop_back(worker_queue& queue) {
+        std::lock_guard lock{queue.mutex};
+        if (queue.tasks.empty()) return std::nullopt;
+        auto task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return task;
+    }
+
+    static std::optional<task_t> pop_front(worker_queue& queue) {
+        std::lock_guard lock{queue.mutex};
+        if (queue.tasks.empty()) return std::nullopt;
+        auto task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return task;
+    }
+
+    std::optional<task_t> find_task() {
+        std::optional<task_t> task{};
+        auto own = (tl_pool == this) ? tl_index : m_queues.size();
+        if (own < m_queues.size()) task = pop_back(*m_queues[own]);
+        if (!task) task = pop_front(m_shared);
+        for (std::size_t i = 1; !task && i <= m_queues.size(); i++)
+            task = pop_front(*m_queues[(own + i) % m_queues.size()]);
+        if (task) m_queued--;
+        return task;
+    }
+
+    void worker_loop(std::size_t index) {
+        tl_pool = this;
+        tl_index = index;
+        while (true) {
+            if (auto task = find_task()) {
+                (*task)();
+                continue;
+            }
+            std::unique_lock lock{m_mutex};
+            m_cv.wait(lock, [this] { return m_stop || m_queued > 0; });
+            if (m_stop) return;
+        }
+    }
+
+    void notify_all() {
+        { std::lock_guard lock{m_mutex}; }
+        m_cv.notify_all();
+    }
+
+    static auto& global_pool() {
+        static std::unique_ptr<thread_pool> pool{};
+        return pool;
+    }
+
+    // the global pool once created, read without locking
+    static auto& global_instance() {
+        static std::atomic<thread_pool*> instance{nullptr};
+        return instance;
+    }
+
+    static auto& global_mutex() {
+        static std::mutex mutex{};
+        return mutex;
+    }
+
+    friend class task_group;
+
+   public:
+    /**
+     * \brief creates a pool able to run thread_count tasks concurrently.
+     *
+     * The thread waiting on the tasks takes part in the work, so thread_count - 1 workers are spawned. Using 0 (the
+     * default) will use all available cores.
+     */
+    explicit thread_pool(std::size_t thread_count = 0) {
+        if (thread_count == 0) thread_count = std::max(1u, std::thread::hardware_concurrency());
+        for (std::size_t i = 0; i + 1 < thread_count; i++) m_queues.push_back(std::make_unique<worker_queue>());
+        for (std::size_t i = 0; i + 1 < thread_count; i++) m_workers.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    ~thread_pool() {
+        {
+            std::lock_guard lock{m_mutex};
+            m_stop = true;
+        }
+        m_cv.notify_all();
+        for (auto& worker : m_workers) worker.join();
+    }
+
+    // number of tasks that can run concurrently, including the waiting thread
+    auto concurrency() const noexcept { return m_workers.size() + 1; }
+
+    void submit(task_t&& task) {
+        auto& queue = (tl_pool == this) ? *m_queues[tl_index] : m_shared;
+        {
+            // counted before it can be popped, so that m_queued never goes below the number of queued tasks
+            std::lock_guard lock{m_mutex};
+            m_queued++;
+            std::lock_guard queue_lock{queue.mutex};
+            queue.tasks.push_back(std::move(task));
+        }
+        m_cv.notify_one();
+    }
+
+    // runs one pending task on the calling thread, returns false if there was none
+    bool try_run_one() {
+        auto task = find_task();
+        if (!task) return false;
+        (*task)();
+        return true;
+    }
+
+    /**
+     * \brief the pool used by hash_tree_root and the other parallel entry points.
+     *
+     * It is created on first use with as many threads as available cores, later calls do not lock.
+     */
+    static thread_pool& global() {
+        if (auto* pool = global_instance().load(std::memory_order_acquire)) return *pool;
+        std::lock_guard lock{global_mutex()};
+        auto& pool = global_pool();
+        if (!pool) {
+            pool = std::make_unique<thread_pool>();
+            global_instance().store(pool.get(), std::memory_order_release);
+        }
+        return *pool;
+    }
+
+    /**
+     * \brief replaces the global pool by one running thread_count tasks concurrently.
+     *
+     * The previous pool is destroyed, so references returned by global() and task_groups bound to it dangle. It must
+     * not be called while any task_group on the global pool is alive or any thread may call global(), it throws
+     * std::logic_error if it detects a live task_group.
+     */
+    static void set_global_threads(std::size_t thread_count) {
+        std::lock_guard lock{global_mutex()};
+        auto& pool = global_pool();
+        if (pool && pool->m_groups > 0) throw std::logic_error("set_global_threads called with a live task_group");
+        auto replacement = std::make_unique<thread_pool>(thread_count);
+        global_instance().store(replacement.get(), std::memory_order_release);
+        pool = std::move(replacement);
+    }
+};
+
+/**
+ * \brief a set of tasks submitted to a thread_pool that can be waited on together.
+ *
+ * wait() executes pending tasks of the pool while the group is not done, and rethrows the first exception thrown by
+ * any of the tasks.
+ */
+class task_group {
+   private:
+    thread_pool& m_pool;
+    std::atomic<std::size_t> m_pending{0};
+    std::mutex m_error_mutex;
+    std::exception_ptr m_error{};
+
+   public:
+    explicit task_group(thread_pool& pool = thread_pool::global()) : m_pool{pool} { m_pool.m_groups++; }
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+    ~task_group() {
+        while (m_pending > 0)
+            if (!m_pool.try_run_one()) std::this_thread::yield();
+        m_pool.m_groups--;
+    }
+
+    template <class F>
+    void run(F&& f) {
+        if (m_pool.m_workers.empty()) {
+            f();
+            return;
+        }
+        m_pending++;
+        m_pool.submit([this, &pool = m_pool, f = std::forward<F>(f)]() mutable {
+            try {
+                f();
+            } catch (...) {
+                std::lock_guard lock{m_error_mutex};
+                if (!m_error) m_error = std::current_exception();
+            }
+            // the group may be destroyed as soon as m_pending reaches zero
+            if (--m_pending == 0) pool.notify_all();
+        });
+    }
+
+    void wait() {
+        while (m_pending > 0) {
+            if (m_pool.try_run_one()) continue;
+            std::unique_lock lock{m_pool.m_mutex};
+            m_pool.m_cv.wait(lock, [this] { return m_pending == 0 || m_pool.m_queued > 0; });
+        }
+        if (m_error) std::rethrow_exception(std::exchange(m_error, nullptr));
+    }
+};
+}  // namespace ssz
@@ -0,0 +1,216 @@
+/*  view.hpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+#include "container.hpp"
+#include "serialized_hash.hpp"
+
+namespace ssz {
+namespace _detail {
+// a string literal usable as a template argument
+template <std::size_t N>
+struct member_name {
+    char value[N];
+    consteval member_name(const char (&name)[N]) { std::copy_n(name, N, value); }
+    constexpr std::string_view str() const noexcept { return {value, N - 1}; }
+};
+
+// the position of name in names, a comma separated list as produced by SSZ_CONT, or the number of names if not found
+consteval std::size_t member_index(std::string_view names, std::string_view name) {
+    constexpr std::string_view blanks{" \t\n\r"};
+    std::size_t index{};
+    while (true) {
+        auto comma = names.find(',');
+        auto current = names.substr(0, comma);
+        current.remove_prefix(std::min(current.find_first_not_of(blanks), current.size()));
+        current.remove_suffix(current.size() - std::min(current.find_last_not_of(blanks) + 1, current.size()));
+        if (current == name) return index;
+        if (comma == std::string_view::npos) return index + 1;
+        names.remove_prefix(comma + 1);
+        index++;
+    }
+}
+
+// the position in the fixed part of its container of the I-th member or of its offset
+template <class T, std::size_t I>
+consteval std::size_t member_position() {
+    return member_positions<members_t<T>>()[I];
+}
+
+// the index of the first variable size member after the I-th one, the number of members if there is none
+template <class T, std::size_t I>
+consteval std::size_t next_variable_member() {
+    constexpr auto member_count = std::tuple_size_v<members_t<T>>;
+    return []<std::size_t... J>(std::index_sequence<J...>) {
+        auto ret = member_count;
+        ((J > I && ret == member_count && ssz_object_variable_size<member_t<T, J>> ? (ret = J) : ret), ...);
+        return ret;
+    }(std::make_index_sequence<member_count>{});
+}
+
+template <class T>
+concept ssz_container_type = requires(const T &t) { t.ssz_members(); };
+
+template <class T>
+concept ssz_sequence_type = list_traits<T>::value || vector_traits<T>::value;
+
+template <class T>
+using sequence_traits = std::conditional_t<list_traits<T>::value, list_traits<T>, vector_traits<T>>;
+
+template <class T>
+using sequence_value_t = typename sequence_traits<T>::value_type;
+}  // namespace _detail
+
+template <ssz_object T>
+class view;
+
+namespace _detail {
+// basic objects are decoded, anything else is wrapped in a view
+template <class T>
+auto make_view(std::span<const std::byte> bytes) {
+    if constexpr (basic_type<T>) {
+        if (bytes.size() != sizeof(T)) throw std::invalid_argument("wrong serialized size");
+        T ret{};
+        deserialize(bytes, ret);
+        return ret;
+    } else {
+        return view<T>{bytes};
+    }
+}
+}  // namespace _detail
+
+/**
+ * \brief a read only view of an object of type T in its serialized form.
+ *
+ * Nothing is decoded when the view is constructed. The members of containers are accessed with get<I>() or
+ * get<"name">() using the names given to SSZ_CONT, and the elements of lists and vectors with operator[]. Basic objects
+ * are returned decoded, anything else as a view of its bytes: fixed size members are read in place and variable size
+ * ones are located through the offsets. The bytes must outlive the view and the views obtained from it. Throws
+ * std::invalid_argument when the offsets or sizes found are inconsistent with T, and std::out_of_range on out of
+ * bounds indices.
+ */
+template <ssz_object T>
+class view {
+   private:
+    std::span<const std::byte> m_bytes;
+
+    std::uint32_t offset_at(std::size_t pos) const { return _detail::read_offset(m_bytes, pos); }
+
+   public:
+    explicit view(std::span<const std::byte> bytes) : m_bytes{bytes} {
+        if constexpr (ssz_object_fixed_size<T> && !basic_type<T>) {
+            if (m_bytes.size() != _detail::static_size<T>()) throw std::invalid_argument("wrong serialized size");
+        } else if constexpr (_detail::ssz_container_type<T>) {
+            if (m_bytes.size() < _detail::fixed_part_size<T>())
+                throw std::invalid_argument("not enough serialized bytes");
+        } else if constexpr (_detail::ssz_sequence_type<T>) {
+            if constexpr (ssz_object_fixed_size<_detail::sequence_value_t<T>>)
+                if (m_bytes.size() % _detail::static_size<_detail::sequence_value_t<T>>() != 0)
+                    throw std::invalid_argument("not a multiple of the element size");
+        }
+    }
+    explicit view(const serialized_range auto &bytes)
+        : view{std::span<const std::byte>{std::ranges::data(bytes), std::ranges::size(bytes)}} {}
+
+    std::span<const std::byte> bytes() const noexcept { return m_bytes; }
+
+    void decode(T &ret) const { deserialize(m_bytes, ret); }
+    T decode() const {
+        T ret{};
+        decode(ret);
+        return ret;
+    }
+
+    chunk_t hash_tree_root() const { return hash_tree_root_serialized<T>(m_bytes); }
+
+    // the I-th member of a container
+    template <std::size_t I>
+        requires _detail::ssz_container_type<T>
+    auto get() const {
+        using member_type = _detail::member_t<T, I>;
+        constexpr auto pos = _detail::member_position<T, I>();
+        if constexpr (ssz_object_fixed_size<member_type>) {
+            return _detail::make_view<member_type>(m_bytes.subspan(pos, _detail::static_size<member_type>()));
+        } else {
+            constexpr auto next = _detail::next_variable_member<T, I>();
+            std::size_t first = offset_at(pos);
+            std::size_t last = m_bytes.size();
+            if constexpr (next < std::tuple_size_v<_detail::members_t<T>>)
+                last = offset_at(_detail::member_position<T, next>());
+            if (first < _detail::fixed_part_size<T>() || first > last || last > m_bytes.size())
+                throw std::invalid_argument("invalid member offset");
+            return _detail::make_view<member_type>(m_bytes.subspan(first, last - first));
+        }
+    }
+
+    // the member of a container named Name in SSZ_CONT
+    template <_detail::member_name Name>
+        requires _detail::ssz_container_type<T>
+    auto get() const {
+        constexpr auto index = _detail::member_index(T::ssz_member_names(), Name.str());
+        static_assert(index < std::tuple_size_v<_detail::members_t<T>>, "no member with this name");
+        return get<index>();
+    }
+
+    // the number of elements of a list or vector
+    std::size_t size() const
+        requires _detail::ssz_sequence_type<T>
+    {
+        using value_type = _detail::sequence_value_t<T>;
+        if constexpr (ssz_object_fixed_size<value_type>) {
+            return m_bytes.size() / _detail::static_size<value_type>();
+        } else {
+            if (m_bytes.empty()) return 0;
+            auto first = offset_at(0);
+            if (first == 0 || first % BYTES_PER_LENGTH_OFFSET != 0 || first > m_bytes.size())
+                throw std::invalid_argument("invalid first offset");
+            return first / BYTES_PER_LENGTH_OFFSET;
+        }
+    }
+
+    // the i-th element of a list or vector
+    auto operator[](std::size_t i) const
+        requires _detail::ssz_sequence_type<T>
+    {
+        using value_type = _detail::sequence_value_t<T>;
+        auto count = size();
+        if (i >= count) throw std::out_of_range("element index out of range");
+        if constexpr (ssz_object_fixed_size<value_type>) {
+            constexpr auto element_size = _detail::static_size<value_type>();
+            return _detail::make_view<value_type>(m_bytes.subspan(i * element_size, element_size));
+        } else {
+            std::size_t first = offset_at(i * BYTES_PER_LENGTH_OFFSET);
+            std::size_t last = (i + 1 < count) ? offset_at((i + 1) * BYTES_PER_LENGTH_OFFSET) : m_bytes.size();
+            if (first < count * BYTES_PER_LENGTH_OFFSET || first > last || last > m_bytes.size())
+                throw std::invalid_argument("invalid element offset");
+            return _detail::make_view<value_type>(m_bytes.subspan(first, last - first));
+        }
+    }
+};
+}  // namespace ssz
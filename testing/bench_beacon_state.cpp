@@ -18,31 +18,27 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
-#include <filesystem>
-#include <fstream>
 #include <memory>
 #include <iostream>
 #include <chrono>
 
 #include "bytelists.hpp"
 #include "container.hpp"
+#include "mapped_file.hpp"
 #include "ssz++.hpp"
 #include "beacon_state.hpp"
 
 constexpr auto file_path = "state.ssz";
 
 int main() {
-    std::ifstream ssz_contents(file_path, std::ios::in | std::ios::binary);
-    if (not ssz_contents.is_open())
-        throw std::filesystem::filesystem_error("could not open file state.ssz", std::error_code());
-
-    const auto ssz_contents_size = std::filesystem::file_size(file_path);
-    std::vector<std::byte> ssz_bytes(ssz_contents_size);
-    ssz_contents.read(reinterpret_cast<char *>(ssz_bytes.data()), ssz_contents_size);
-    ssz_contents.close();
+    const auto start_mapping = std::chrono::high_resolution_clock::now();
+    ssz::mapped_file ssz_bytes{file_path};
+    const auto end_mapping = std::chrono::high_resolution_clock::now();
+    const std::chrono::duration<double> elapsed_mapping = end_mapping - start_mapping;
 
     const auto start_deserialize = std::chrono::high_resolution_clock::now();
-    std::unique_ptr<ssz::beacon_state_t> state{ssz::deserialize<ssz::beacon_state_t*>(ssz_bytes)};
+    auto state = std::make_unique<ssz::beacon_state_t>();
+    ssz::deserialize_parallel(ssz_bytes, *state);
     const auto end_deserialize = std::chrono::high_resolution_clock::now();
     const std::chrono::duration<double> elapsed_deserialize = end_deserialize - start_deserialize;
 
@@ -51,7 +47,8 @@ int main() {
     const auto end_hashing = std::chrono::high_resolution_clock::now();
     const std::chrono::duration<double> elapsed_hashing = end_hashing - start_hashing;
 
-    std::cout << "Deserialization: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_deserialize)
+    std::cout << "Mapping: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_mapping)
+              << "\nDeserialization: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_deserialize)
               << "\nHashing: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed_hashing)
               << "\nRoot: " << ssz::to_string(htr) << std::endl;
 
@@ -0,0 +1,591 @@
+/*  hashing_test.cpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <random>
+#include <utility>
+
+#include "acutest.h"
+#include "beacon_state.hpp"
+#include "cached_tree.hpp"
+#include "pubkey_cache.hpp"
+#include "ssz++.hpp"
+
+namespace {
+constexpr auto registry_limit = ssz::VALIDATOR_REGISTRY_LIMIT;
+
+// counts the calls to the replaced operator new below
+std::atomic<std::size_t> allocations{};
+
+auto random_validators(std::mt19937_64 &gen, std::size_t count) {
+    std::vector<ssz::validator_t> ret(count);
+    for (auto &v : ret) {
+        v.pubkey[0] = std::byte(gen());
+        v.withdrawal_credentials[31] = std::byte(gen());
+        v.effective_balance = gen();
+        v.exit_epoch = gen();
+    }
+    return ret;
+}
+}  // namespace
+
+void *operator new(std::size_t size) {
+    allocations++;
+    if (auto ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc{};
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+    allocations++;
+    auto align = static_cast<std::size_t>(alignment);
+    if (auto ptr = std::aligned_alloc(align, (size + align) / align * align)) return ptr;
+    throw std::bad_alloc{};
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+void test_cached_list_basic() {
+    std::mt19937_64 gen{1};
+    for (std::size_t count : {0ul, 1ul, 3ul, 4ul, 5ul, 17ul, 1000ul, 4097ul}) {
+        std::vector<std::uint64_t> balances(count);
+        std::ranges::generate(balances, gen);
+        ssz::list<std::uint64_t, registry_limit> plain{balances};
+        ssz::cached_list<std::uint64_t, registry_limit> cached{balances};
+        ssz::chunk_t expected{}, obtained{};
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), cached);
+        TEST_CHECK(expected == obtained);
+        TEST_MSG("Wrong root for %lu balances", count);
+
+        for (std::size_t i = 0; i < 5 && count; i++) {
+            auto idx = gen() % count;
+            plain[idx] = gen();
+            cached.set(idx, plain[idx]);
+        }
+        for (std::size_t i = 0; i < 3; i++) {
+            plain.push_back(gen());
+            cached.push_back(plain[plain.size() - 1]);
+        }
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), cached);
+        TEST_CHECK(expected == obtained);
+        TEST_MSG("Wrong root after updating %lu balances", count);
+    }
+}
+
+void test_cached_list_containers() {
+    std::mt19937_64 gen{2};
+    for (std::size_t count : {0ul, 1ul, 2ul, 5ul, 100ul, 1025ul}) {
+        auto validators = random_validators(gen, count);
+        ssz::list<ssz::validator_t, registry_limit> plain{validators};
+        ssz::cached_list<ssz::validator_t, registry_limit> cached{validators};
+        ssz::chunk_t expected{}, obtained{};
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), cached);
+        TEST_CHECK(expected == obtained);
+
+        for (std::size_t i = 0; i < 5 && count; i++) {
+            auto idx = gen() % count;
+            plain[idx].exit_epoch = gen();
+            cached[idx].exit_epoch = plain[idx].exit_epoch;
+        }
+        plain.push_back(ssz::validator_t{});
+        cached.push_back(ssz::validator_t{});
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), cached);
+        TEST_CHECK(expected == obtained);
+        // writes through the non-const end() are seen by the next hash
+        std::prev(plain.end())->slashed = true;
+        std::prev(cached.end())->slashed = true;
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), cached);
+        TEST_CHECK(expected == obtained);
+
+        auto bytes = ssz::serialize(cached);
+        TEST_CHECK(bytes == ssz::serialize(plain));
+        auto deserialized = ssz::deserialize<ssz::cached_list<ssz::validator_t, registry_limit>>(bytes);
+        TEST_CHECK(deserialized == cached);
+        TEST_CHECK(ssz::hash_tree_root(deserialized) == expected);
+    }
+}
+
+void test_list_element_roots() {
+    std::mt19937_64 gen{12};
+    using list_t = ssz::list<ssz::validator_t, registry_limit>;
+    list_t validators{random_validators(gen, 3000)};
+    ssz::chunk_t unused{};
+    ssz::hash_tree_root(std::begin(unused), validators);
+    TEST_CHECK(validators.root_cache() == nullptr);
+    validators.enable_root_cache();
+    // a copy keeps the setting but starts without the cached roots, so it is hashed from scratch
+    auto check = [&validators] {
+        list_t fresh{validators};
+        TEST_CHECK(fresh == validators);
+        ssz::chunk_t cached{}, expected{};
+        ssz::hash_tree_root(std::begin(cached), validators);
+        ssz::hash_tree_root(std::begin(expected), fresh);
+        TEST_CHECK(cached == expected);
+        TEST_CHECK(validators.root_cache() != nullptr);
+    };
+    check();
+    for (std::size_t i = 0; i < 10; i++) validators[gen() % validators.size()].effective_balance = gen();
+    check();
+    validators.push_back(ssz::validator_t{});
+    validators.push_back(ssz::validator_t{.slashed = true});
+    check();
+    std::ranges::reverse(validators);
+    check();
+    // different elements written concurrently
+    {
+        ssz::task_group tasks{};
+        for (std::size_t t = 0; t < 4; t++)
+            tasks.run([&validators, t] {
+                for (std::size_t i = t; i < validators.size(); i += 64) validators[i].withdrawable_epoch = i;
+            });
+        tasks.wait();
+    }
+    check();
+    validators.data().resize(3);
+    check();
+    for (std::size_t i = 0; i < 2000; i++) validators.push_back(ssz::validator_t{.effective_balance = i});
+    check();
+    auto replacement = random_validators(gen, 70000);
+    validators.reset(replacement);
+    check();
+    validators[69999].exit_epoch = 1;
+    check();
+    // the same list hashed from several threads at once, all but one of them without the cache
+    ssz::thread_pool::set_global_threads(3);
+    validators[12].slashed = true;
+    std::array<ssz::chunk_t, 4> roots{};
+    {
+        ssz::task_group tasks{};
+        for (auto& root : roots) tasks.run([&validators, &root] { ssz::hash_tree_root(std::begin(root), validators, 2); });
+        tasks.wait();
+    }
+    ssz::chunk_t expected{};
+    ssz::hash_tree_root(std::begin(expected), list_t{validators});
+    TEST_CHECK(std::ranges::all_of(roots, [&expected](const auto& root) { return root == expected; }));
+    check();
+}
+
+void test_cached_vector() {
+    std::mt19937_64 gen{3};
+    auto plain = std::make_unique<std::array<ssz::Root, ssz::SLOTS_PER_HISTORICAL_ROOT>>();
+    auto cached = std::make_unique<ssz::cached_vector<ssz::Root, ssz::SLOTS_PER_HISTORICAL_ROOT>>();
+    TEST_CHECK(ssz::hash_tree_root(*plain) == ssz::hash_tree_root(*cached));
+    for (std::size_t i = 0; i < 10; i++) {
+        auto idx = gen() % ssz::SLOTS_PER_HISTORICAL_ROOT;
+        (*plain)[idx][0] = std::byte(gen());
+        cached->set(idx, (*plain)[idx]);
+        TEST_CHECK(ssz::hash_tree_root(*plain, 1) == ssz::hash_tree_root(*cached));
+    }
+
+    std::array<ssz::Gwei, ssz::EPOCHS_PER_SLASHINGS_VECTOR> slashings{};
+    ssz::cached_vector<ssz::Gwei, ssz::EPOCHS_PER_SLASHINGS_VECTOR> cached_slashings{};
+    slashings[5] = cached_slashings[5] = 7;
+    TEST_CHECK(ssz::hash_tree_root(slashings, 1) == ssz::hash_tree_root(cached_slashings));
+    slashings.back() = 9;
+    *std::prev(cached_slashings.end()) = 9;
+    TEST_CHECK(ssz::hash_tree_root(slashings, 1) == ssz::hash_tree_root(cached_slashings));
+}
+
+void test_shared_state_copies() {
+    std::mt19937_64 gen{8};
+    auto state = std::make_unique<ssz::beacon_state_t>();
+    auto validators = random_validators(gen, 1000);
+    state->validators.reset(validators);
+    std::vector<ssz::Gwei> balances(1000);
+    std::ranges::generate(balances, gen);
+    state->balances.reset(balances);
+    auto expected = ssz::hash_tree_root(*state);
+    auto exit_epoch = std::as_const(state->validators)[5].exit_epoch;
+
+    auto copy = std::make_unique<ssz::beacon_state_t>(*state);
+    TEST_CHECK(copy->validators.shares_with(state->validators));
+    TEST_CHECK(copy->randao_mixes.shares_with(ssz::beacon_state_t{}.randao_mixes));
+    copy->balances[3] = gen();
+    copy->validators[5].exit_epoch = gen();
+    copy->randao_mixes.set(7, ssz::Root{std::byte{1}});
+    TEST_CHECK(!copy->balances.shares_with(state->balances));
+    TEST_CHECK(copy->state_roots.shares_with(state->state_roots));
+    TEST_CHECK(*copy != *state);
+
+    TEST_CHECK(ssz::hash_tree_root(*state) == expected);
+    TEST_CHECK(ssz::hash_tree_root(*copy) ==
+               ssz::hash_tree_root_serialized<ssz::beacon_state_t>(ssz::serialize(*copy)));
+    TEST_CHECK(std::as_const(state->validators)[5].exit_epoch == exit_epoch);
+
+    // copies that share their elements hashed at once, each with batches on several threads
+    ssz::thread_pool::set_global_threads(3);
+    auto count = 2 * ssz::_detail::batch_hash_size + 5;
+    ssz::cached_list<ssz::validator_t, registry_limit> shared{random_validators(gen, count)};
+    std::vector copies(4, shared);
+    ssz::chunk_t plain_root{};
+    ssz::hash_tree_root(std::begin(plain_root), ssz::list<ssz::validator_t, registry_limit>{shared.data()}, 1);
+    std::array<ssz::chunk_t, 4> roots{};
+    {
+        ssz::task_group tasks{};
+        for (std::size_t i = 0; i < copies.size(); i++)
+            tasks.run([&copies, &roots, i] { roots[i] = ssz::hash_tree_root(copies[i], 2); });
+        tasks.wait();
+    }
+    TEST_CHECK(std::ranges::all_of(roots, [&plain_root](const auto& root) { return root == plain_root; }));
+    copies[1][7].slashed = true;
+    TEST_CHECK(ssz::hash_tree_root(copies[0], 0) == plain_root);
+    TEST_CHECK(ssz::hash_tree_root(copies[1], 0) != plain_root);
+}
+
+void test_persistent_list() {
+    std::mt19937_64 gen{9};
+    for (std::size_t count : {0ul, 1ul, 16ul, 17ul, 1000ul}) {
+        auto validators = random_validators(gen, count);
+        ssz::list<ssz::validator_t, registry_limit> plain{validators};
+        ssz::persistent_list<ssz::validator_t, registry_limit> persistent{validators};
+        std::vector<ssz::Gwei> balances(count);
+        std::ranges::generate(balances, gen);
+        ssz::list<ssz::Gwei, registry_limit> plain_balances{balances};
+        ssz::persistent_list<ssz::Gwei, registry_limit> persistent_balances{balances};
+        ssz::chunk_t expected{}, expected_balances{};
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(expected_balances), plain_balances, 1);
+        TEST_CHECK(ssz::hash_tree_root(persistent) == expected);
+        TEST_CHECK(ssz::hash_tree_root(persistent_balances) == expected_balances);
+        TEST_CHECK(ssz::serialize(persistent) == ssz::serialize(plain));
+        TEST_MSG("Wrong serialization of %lu validators", count);
+
+        auto version = persistent;
+        for (std::size_t i = 0; i < 5 && count; i++) {
+            auto idx = gen() % count;
+            plain[idx].exit_epoch = gen();
+            persistent.update(idx, [&](auto &v) { v.exit_epoch = plain[idx].exit_epoch; });
+            plain_balances[idx] = gen();
+            persistent_balances.set(idx, plain_balances[idx]);
+        }
+        for (std::size_t i = 0; i < 20; i++) {
+            plain.push_back(ssz::validator_t{});
+            persistent.push_back(ssz::validator_t{});
+        }
+        TEST_CHECK(ssz::hash_tree_root(version) == expected);
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(expected_balances), plain_balances, 1);
+        TEST_CHECK(ssz::hash_tree_root(persistent) == expected);
+        TEST_CHECK(ssz::hash_tree_root(persistent_balances) == expected_balances);
+        TEST_MSG("Wrong root after updating %lu validators", count);
+
+        auto deserialized =
+            ssz::deserialize<ssz::persistent_list<ssz::validator_t, registry_limit>>(ssz::serialize(plain));
+        TEST_CHECK(deserialized == persistent);
+    }
+}
+
+void test_persistent_vector() {
+    std::mt19937_64 gen{13};
+    constexpr auto length = ssz::EPOCHS_PER_HISTORICAL_VECTOR;
+    auto plain = std::make_unique<std::array<ssz::Root, length>>();
+    ssz::persistent_vector<ssz::Root, length> mixes{};
+    auto zero_root = ssz::hash_tree_root(*plain, 1);
+    TEST_CHECK(ssz::hash_tree_root(mixes) == zero_root);
+
+    auto copy = mixes;
+    for (std::size_t epoch = 0; epoch < 10; epoch++) {
+        auto idx = epoch * 7919 % length;
+        (*plain)[idx][0] = std::byte(gen());
+        copy.set(idx, (*plain)[idx]);
+        TEST_CHECK(ssz::hash_tree_root(*plain, 1) == ssz::hash_tree_root(copy));
+    }
+    TEST_CHECK(!copy.shares_with(mixes));
+    TEST_CHECK(ssz::hash_tree_root(mixes) == zero_root);
+    TEST_CHECK((copy == ssz::persistent_vector<ssz::Root, length>{*plain}));
+
+    auto bytes = ssz::serialize(copy);
+    TEST_CHECK(bytes == ssz::serialize(*plain));
+    auto deserialized = ssz::deserialize<ssz::persistent_vector<ssz::Root, length>>(bytes);
+    TEST_CHECK(deserialized == copy);
+
+    // writes through operator[] go through set() and update()
+    auto written = copy;
+    written[3] = (*plain)[7919];
+    written[4][31] = std::byte{5};
+    written[5] = written[3];
+    TEST_CHECK(written[3] == (*plain)[7919] && written[5] == (*plain)[7919]);
+    TEST_CHECK(written[4][31] == std::byte{5});
+    TEST_CHECK(std::as_const(copy)[3] == (*plain)[3]);
+    (*plain)[3] = (*plain)[5] = (*plain)[7919];
+    (*plain)[4][31] = std::byte{5};
+    TEST_CHECK(ssz::hash_tree_root(*plain, 1) == ssz::hash_tree_root(written));
+    ssz::persistent_vector<ssz::Gwei, ssz::EPOCHS_PER_SLASHINGS_VECTOR> slashings{};
+    slashings[9] += 32;
+    slashings[9] -= 2;
+    TEST_CHECK(std::as_const(slashings)[9] == 30);
+
+    // full subtrees of repeated elements are shared
+    for (std::size_t count : {1ul, 64ul, 65ul, 1000ul}) {
+        ssz::persistent_list<std::uint64_t, 4096> filled(count, 7);
+        ssz::persistent_list<std::uint64_t, 4096> assigned{std::vector<std::uint64_t>(count, 7)};
+        TEST_CHECK(filled == assigned);
+        TEST_CHECK(ssz::hash_tree_root(filled) == ssz::hash_tree_root(assigned));
+    }
+}
+
+void test_validator_registry() {
+    std::mt19937_64 gen{10};
+    for (std::size_t count : {0ul, 1ul, 3ul, 1000ul, 3000ul}) {
+        auto validators = random_validators(gen, count);
+        for (auto &v : validators) v.slashed = gen() & 1;
+        ssz::list<ssz::validator_t, registry_limit> plain{validators};
+        ssz::validator_registry_t registry{validators};
+        registry.enable_root_cache();
+        ssz::chunk_t expected{}, obtained{};
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), registry);
+        TEST_CHECK(expected == obtained);
+        TEST_MSG("Wrong root for a registry of %lu validators", count);
+        TEST_CHECK(ssz::serialize(registry) == ssz::serialize(plain));
+        TEST_CHECK(ssz::deserialize<ssz::validator_registry_t>(ssz::serialize(plain)) == registry);
+
+        auto exit_epochs = registry.column<&ssz::validator_t::exit_epoch>();
+        for (std::size_t i = 0; i < count; i += 7) {
+            plain[i].exit_epoch = exit_epochs[i] = gen();
+            TEST_CHECK(registry[i] == plain[i]);
+        }
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), registry, 4);
+        TEST_CHECK(expected == obtained);
+
+        // writes after a hash are tracked by the cached roots
+        for (std::size_t i = 0; i < count; i += 97) {
+            plain[i].effective_balance = gen();
+            registry.set(i, plain[i]);
+        }
+        plain.push_back(ssz::validator_t{.slashed = true});
+        registry.push_back(ssz::validator_t{.slashed = true});
+        ssz::hash_tree_root(std::begin(expected), plain, 1);
+        ssz::hash_tree_root(std::begin(obtained), registry, 4);
+        TEST_CHECK(expected == obtained);
+        TEST_CHECK(ssz::subtree_root(registry, ssz::generalized_index<ssz::validator_registry_t>({count})) ==
+                   ssz::hash_tree_root(plain[count]));
+    }
+    std::vector<std::byte> bytes(ssz::validator_t::ssz_fixed_part_size);
+    bytes[ssz::validator_t::ssz_member_positions[3]] = std::byte{2};
+    TEST_EXCEPTION(ssz::deserialize<ssz::validator_registry_t>(bytes), std::invalid_argument);
+}
+
+void test_pubkey_root_cache() {
+    std::mt19937_64 gen{11};
+    auto validators = random_validators(gen, 70000);
+    ssz::list<ssz::validator_t, registry_limit> plain{validators};
+    ssz::pubkey_root_cache cache{};
+    ssz::chunk_t expected{}, obtained{};
+    ssz::hash_tree_root(std::begin(expected), plain, 1);
+    ssz::hash_tree_root(std::begin(obtained), plain, cache, 4);
+    TEST_CHECK(expected == obtained);
+    TEST_CHECK(cache.entries.size() == plain.size());
+    TEST_CHECK(cache.entries[17].root == ssz::hash_tree_root(plain[17].pubkey));
+
+    auto bytes = ssz::serialize(cache);
+    TEST_CHECK(bytes == ssz::serialize(ssz::list<ssz::pubkey_root_t, ssz::VALIDATOR_REGISTRY_LIMIT>{cache.entries}));
+    ssz::pubkey_root_cache reloaded{};
+    ssz::deserialize(bytes, reloaded);
+    TEST_CHECK(reloaded == cache);
+    plain[5].pubkey[9] = std::byte{1};
+    plain.push_back(ssz::validator_t{});
+    ssz::hash_tree_root(std::begin(expected), plain, 1);
+    ssz::hash_tree_root(std::begin(obtained), plain, reloaded, 1);
+    TEST_CHECK(expected == obtained);
+    TEST_CHECK(reloaded.entries[5].pubkey == plain[5].pubkey);
+
+    // changed pubkeys in every parallel batch are hashed again
+    ssz::thread_pool::set_global_threads(4);
+    for (std::size_t i = 0; i < plain.size(); i += ssz::_detail::batch_hash_size) plain[i].pubkey[0] ^= std::byte{1};
+    ssz::hash_tree_root(std::begin(expected), plain, 1);
+    ssz::hash_tree_root(std::begin(obtained), plain, cache, 4);
+    TEST_CHECK(expected == obtained);
+    TEST_CHECK(cache.entries[ssz::_detail::batch_hash_size].root ==
+               ssz::hash_tree_root(plain[ssz::_detail::batch_hash_size].pubkey));
+}
+
+void test_thread_pool() {
+    std::mt19937_64 gen{4};
+    auto validators = random_validators(gen, 3000);
+    ssz::list<ssz::validator_t, registry_limit> list{validators};
+    auto expected = ssz::hash_tree_root(validators, 1, registry_limit);
+    for (std::size_t threads : {1, 3, 4}) {
+        ssz::thread_pool::set_global_threads(threads);
+        for (std::size_t cpu_count : {0, 2, 3, 6, 16}) {
+            TEST_CHECK(ssz::hash_tree_root(validators, cpu_count, registry_limit) == expected);
+            TEST_MSG("Wrong root with %lu threads and cpu_count %lu", threads, cpu_count);
+        }
+    }
+
+    ssz::thread_pool pool{2};
+    ssz::task_group tasks{pool};
+    tasks.run([] { throw std::runtime_error("task failed"); });
+    TEST_EXCEPTION(tasks.wait(), std::runtime_error);
+
+    {
+        ssz::task_group live{};
+        TEST_EXCEPTION(ssz::thread_pool::set_global_threads(2), std::logic_error);
+    }
+    ssz::thread_pool::set_global_threads(2);
+}
+
+void test_concurrent_members() {
+    std::mt19937_64 gen{5};
+    auto state = std::make_unique<ssz::beacon_state_t>();
+    auto validators = random_validators(gen, 3000);
+    state->validators.reset(validators);
+    std::vector<ssz::Gwei> balances(3000);
+    std::ranges::generate(balances, gen);
+    state->balances.reset(balances);
+    state->randao_mixes[17][3] = std::byte{9};
+    state->slot = gen();
+    auto expected = ssz::hash_tree_root(*state, 1);
+    ssz::thread_pool::set_global_threads(4);
+    for (std::size_t cpu_count : {0, 2, 3, 16}) {
+        TEST_CHECK(ssz::hash_tree_root(*state, cpu_count) == expected);
+        TEST_MSG("Wrong state root with cpu_count %lu", cpu_count);
+    }
+
+    // transactions weigh their bytes, so that a payload with large transactions hashes them in parallel
+    ssz::execution_payload_t payload{};
+    for (std::size_t size : {100000ul, 3ul, 70000ul})
+        payload.transactions.push_back(ssz::transaction_t{std::vector<std::byte>(size)});
+    payload.transactions[2][9] = std::byte{1};
+    TEST_CHECK(ssz::_detail::hash_weight(payload.transactions) == 170003);
+    auto payload_root = ssz::hash_tree_root(payload, 1);
+    TEST_CHECK(ssz::hash_tree_root(payload, 4) == payload_root);
+}
+
+void test_batched_containers() {
+    std::mt19937_64 gen{6};
+    std::vector<ssz::deposit_t> deposits(70);
+    for (auto &d : deposits) {
+        d.proof[gen() % d.proof.size()][3] = std::byte(gen());
+        d.data.pubkey[47] = std::byte(gen());
+        d.data.amount = gen();
+    }
+    std::vector<std::byte> roots(deposits.size() * ssz::BYTES_PER_CHUNK);
+    for (std::size_t i = 0; i < deposits.size(); i++)
+        ssz::hash_tree_root(std::begin(roots) + i * ssz::BYTES_PER_CHUNK, deposits[i], 1);
+    ssz::chunk_t expected{}, obtained{};
+    ssz::hash_tree_root(std::begin(expected), roots, 1);
+    ssz::hash_tree_root(std::begin(obtained), deposits, 1);
+    TEST_CHECK(expected == obtained);
+}
+
+void test_serialized_roots() {
+    std::mt19937_64 gen{7};
+    auto state = std::make_unique<ssz::beacon_state_t>();
+    auto validators = random_validators(gen, 1001);
+    state->validators.reset(validators);
+    std::vector<std::uint8_t> participation(1003);
+    std::ranges::generate(participation, gen);
+    state->current_epoch_participation.reset(participation);
+    state->justification_bits[2] = true;
+    auto bytes = ssz::serialize(*state);
+    TEST_CHECK(ssz::hash_tree_root_serialized<ssz::beacon_state_t>(bytes) == ssz::hash_tree_root(*state, 1));
+
+    ssz::attestation_t attestation{};
+    for (std::size_t bits : {0ul, 7ul, 8ul, 255ul, 256ul, 2048ul}) {
+        attestation.aggregation_bits.data().assign(bits, true);
+        TEST_CHECK(ssz::hash_tree_root_serialized<ssz::attestation_t>(ssz::serialize(attestation)) ==
+                   ssz::hash_tree_root(attestation, 1));
+        TEST_MSG("Wrong root for %lu aggregation bits", bits);
+    }
+    bytes.pop_back();
+    TEST_EXCEPTION(ssz::hash_tree_root_serialized<ssz::beacon_state_t>(bytes), std::invalid_argument);
+}
+
+void test_scratch_arena() {
+    std::byte* outer_data{};
+    {
+        ssz::_detail::scratch_buffer outer{100};
+        outer_data = outer.data();
+        std::ranges::fill(outer, std::byte{0xff});
+        {
+            // larger than a block, forces a second one
+            ssz::_detail::scratch_buffer inner{1 << 20};
+            TEST_CHECK(std::ranges::all_of(inner, [](auto b) { return b == std::byte{}; }));
+            TEST_CHECK(inner.data() >= outer.end() || inner.end() <= outer.data());
+        }
+        ssz::_detail::scratch_buffer inner{1 << 20};
+        TEST_CHECK(std::ranges::all_of(outer, [](auto b) { return b == std::byte{0xff}; }));
+    }
+    ssz::_detail::scratch_buffer again{100};
+    TEST_CHECK(again.data() == outer_data);
+    TEST_CHECK(std::ranges::all_of(again, [](auto b) { return b == std::byte{}; }));
+}
+
+void test_scratch_trim() {
+    auto& arena = ssz::_detail::scratch_arena::local();
+    {
+        ssz::_detail::scratch_buffer outer{100};
+        ssz::_detail::scratch_buffer large{1 << 24};
+        TEST_CHECK(arena.reserved() >= (1 << 24));
+        // nothing is freed while a buffer is in use
+        arena.release();
+        TEST_CHECK(arena.reserved() >= (1 << 24));
+    }
+    // the peak is kept until it is trimmed
+    TEST_CHECK(arena.reserved() >= (1 << 24));
+    arena.trim(1 << 22);
+    TEST_CHECK(arena.reserved() <= (1 << 22));
+    arena.release();
+    TEST_CHECK(arena.reserved() == 0);
+}
+
+void test_scratch_reuse() {
+    std::mt19937_64 gen{14};
+    // more than the 4 MiB that arenas used to keep
+    auto validators = random_validators(gen, 200000);
+    auto& arena = ssz::_detail::scratch_arena::local();
+    arena.release();
+    auto first = ssz::hash_tree_root(validators, 1, registry_limit);
+    auto before = allocations.load();
+    auto second = ssz::hash_tree_root(validators, 1, registry_limit);
+    TEST_CHECK(allocations.load() == before);
+    TEST_MSG("%lu allocations when hashing again", allocations.load() - before);
+    TEST_CHECK(first == second);
+    TEST_CHECK(arena.reserved() >= validators.size() * ssz::BYTES_PER_CHUNK);
+    arena.release();
+}
+
+TEST_LIST{{"cached_list_basic", test_cached_list_basic},
+          {"cached_list_containers", test_cached_list_containers},
+          {"list_element_roots", test_list_element_roots},
+          {"cached_vector", test_cached_vector},
+          {"shared_state_copies", test_shared_state_copies},
+          {"persistent_list", test_persistent_list},
+          {"persistent_vector", test_persistent_vector},
+          {"validator_registry", test_validator_registry},
+          {"pubkey_root_cache", test_pubkey_root_cache},
+          {"thread_pool", test_thread_pool},
+          {"concurrent_members", test_concurrent_members},
+          {"batched_containers", test_batched_containers},
+          {"serialized_roots", test_serialized_roots},
+          {"scratch_arena", test_scratch_arena},
+          {"scratch_trim", test_scratch_trim},
+          {"scratch_reuse", test_scratch_reuse},
+          {NULL, NULL}};
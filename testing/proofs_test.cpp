@@ -0,0 +1,156 @@
+/*  proofs_test.cpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <random>
+
+#include "acutest.h"
+#include "beacon_state.hpp"
+#include "proofs.hpp"
+#include "ssz++.hpp"
+
+namespace {
+using state_t = ssz::beacon_state_t;
+
+auto random_state(std::mt19937_64 &gen) {
+    auto state = std::make_unique<state_t>();
+    std::vector<ssz::validator_t> validators(300);
+    for (auto &v : validators) {
+        v.pubkey[0] = std::byte(gen());
+        v.effective_balance = gen();
+    }
+    state->validators.reset(validators);
+    std::vector<ssz::Gwei> balances(301);
+    std::ranges::generate(balances, gen);
+    state->balances.reset(balances);
+    state->finalized_checkpoint.root[5] = std::byte(gen());
+    state->next_sync_committee.pubkeys[7][1] = std::byte(gen());
+    state->block_roots[77][0] = std::byte(gen());
+    return state;
+}
+}  // namespace
+
+void test_generalized_index() {
+    // values from the light client spec
+    TEST_CHECK(ssz::generalized_index<state_t>({20, 1}) == 105);
+    TEST_CHECK(ssz::generalized_index<state_t>({22}) == 54);
+    TEST_CHECK(ssz::generalized_index<state_t>({23}) == 55);
+    TEST_EXCEPTION(ssz::generalized_index<state_t>({28}), std::out_of_range);
+    TEST_EXCEPTION(ssz::generalized_index<state_t>({2, 0}), std::invalid_argument);
+}
+
+void test_single_proofs() {
+    std::mt19937_64 gen{1};
+    auto state = random_state(gen);
+    auto root = ssz::hash_tree_root(*state, 1);
+    std::vector<std::vector<std::size_t>> paths{{23},      {20, 1},  {11, 17, 2}, {11, 299, 0}, {11, ssz::length_index},
+                                                {12, 300}, {5, 77},  {23, 0, 7},  {17},         {}};
+    for (const auto &path : paths) {
+        auto gindex = ssz::generalized_index<state_t>(std::span{path});
+        auto proof = ssz::compute_merkle_proof(*state, gindex);
+        TEST_CHECK(ssz::verify_merkle_proof(proof, gindex, root));
+        TEST_MSG("Invalid proof for generalized index %lu", gindex);
+        TEST_CHECK(ssz::subtree_root(*state, gindex) == proof.leaf);
+    }
+    auto proof = ssz::compute_merkle_proof(*state, ssz::generalized_index<state_t>({11, 17, 2}));
+    ssz::chunk_t balance{};
+    ssz::serialize(std::begin(balance), state->validators[17].effective_balance);
+    TEST_CHECK(proof.leaf == balance);
+    proof.leaf[0] ^= std::byte{1};
+    TEST_CHECK(!ssz::verify_merkle_proof(proof, ssz::generalized_index<state_t>({11, 17, 2}), root));
+    TEST_EXCEPTION(ssz::compute_merkle_proof(*state, ssz::generalized_index<state_t>({11, 300, 0})), std::out_of_range);
+}
+
+void test_cached_proofs() {
+    std::mt19937_64 gen{2};
+    std::vector<std::uint64_t> balances(1000);
+    std::ranges::generate(balances, gen);
+    ssz::list<std::uint64_t, ssz::VALIDATOR_REGISTRY_LIMIT> plain{balances};
+    ssz::cached_list<std::uint64_t, ssz::VALIDATOR_REGISTRY_LIMIT> cached{balances};
+    for (std::size_t idx : {0ul, 333ul, 999ul}) {
+        auto gindex = ssz::generalized_index<decltype(plain)>({idx});
+        auto expected = ssz::compute_merkle_proof(plain, gindex);
+        auto obtained = ssz::compute_merkle_proof(cached, gindex);
+        TEST_CHECK(expected.leaf == obtained.leaf && expected.branch == obtained.branch);
+        TEST_MSG("Different proofs for balance %lu", idx);
+    }
+
+    // lists of validators with and without their element roots kept
+    std::vector<ssz::validator_t> validators(300);
+    for (auto &v : validators) v.effective_balance = gen();
+    using list_t = ssz::list<ssz::validator_t, ssz::VALIDATOR_REGISTRY_LIMIT>;
+    list_t uncached{validators}, with_roots{validators};
+    with_roots.enable_root_cache();
+    ssz::validator_registry_t registry{validators}, registry_with_roots{validators};
+    registry_with_roots.enable_root_cache();
+    for (std::vector<std::size_t> path : {std::vector<std::size_t>{0, 3}, {150}, {299, 0}, {ssz::length_index}}) {
+        auto gindex = ssz::generalized_index<list_t>(std::span{path});
+        auto expected = ssz::compute_merkle_proof(uncached, gindex);
+        for (const auto &obtained :
+             {ssz::compute_merkle_proof(with_roots, gindex), ssz::compute_merkle_proof(registry, gindex),
+              ssz::compute_merkle_proof(registry_with_roots, gindex)})
+            TEST_CHECK(expected.leaf == obtained.leaf && expected.branch == obtained.branch);
+    }
+    TEST_CHECK(ssz::subtree_root(with_roots, 2) == ssz::subtree_root(uncached, 2));
+    TEST_CHECK(ssz::subtree_root(registry, 2) == ssz::subtree_root(uncached, 2));
+    TEST_CHECK(with_roots.root_cache() != nullptr && uncached.root_cache() == nullptr);
+
+    // the element roots of long lists are computed in batches on several threads
+    list_t large{std::vector<ssz::validator_t>(2 * ssz::_detail::batch_hash_size + 3)};
+    for (std::size_t i = 0; i < large.size(); i += 1000) large[i].effective_balance = i;
+    auto gindex = ssz::generalized_index<list_t>({large.size() - 1});
+    auto expected = ssz::compute_merkle_proof(large, gindex, 1);
+    ssz::thread_pool::set_global_threads(3);
+    auto obtained = ssz::compute_merkle_proof(large, gindex);
+    TEST_CHECK(expected.leaf == obtained.leaf && expected.branch == obtained.branch);
+    ssz::chunk_t root{};
+    ssz::hash_tree_root(std::begin(root), large, 1);
+    TEST_CHECK(ssz::verify_merkle_proof(obtained, gindex, root));
+}
+
+void test_multiproofs() {
+    std::vector<ssz::gindex_t> simple{8, 9, 14};
+    TEST_CHECK(ssz::get_helper_indices(simple) == std::vector<ssz::gindex_t>({15, 6, 5}));
+
+    std::mt19937_64 gen{3};
+    auto state = random_state(gen);
+    auto root = ssz::hash_tree_root(*state, 1);
+    std::vector<ssz::gindex_t> indices{ssz::generalized_index<state_t>({20, 1}), ssz::generalized_index<state_t>({23})};
+    for (std::size_t idx : {3ul, 4ul, 100ul, 299ul}) {
+        indices.push_back(ssz::generalized_index<state_t>({11, idx, 2}));
+        indices.push_back(ssz::generalized_index<state_t>({12, idx}));
+    }
+    auto multiproof = ssz::compute_merkle_multiproof(*state, indices);
+    TEST_CHECK(ssz::verify_merkle_multiproof(multiproof, indices, root));
+    for (std::size_t i = 0; i < indices.size(); i++)
+        TEST_CHECK(multiproof.leaves[i] == ssz::subtree_root(*state, indices[i]));
+    multiproof.proof.back()[0] ^= std::byte{1};
+    TEST_CHECK(!ssz::verify_merkle_multiproof(multiproof, indices, root));
+
+    // a multiproof of a single index is its branch
+    auto single = ssz::compute_merkle_multiproof(*state, std::span{indices.begin(), 1});
+    TEST_CHECK(single.proof == ssz::compute_merkle_proof(*state, indices[0]).branch);
+}
+
+TEST_LIST{{"generalized_index", test_generalized_index},
+          {"single_proofs", test_single_proofs},
+          {"cached_proofs", test_cached_proofs},
+          {"multiproofs", test_multiproofs},
+          {NULL, NULL}};
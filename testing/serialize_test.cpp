@@ -18,13 +18,22 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <sstream>
 
 #include "acutest.h"
+#include "beacon_block.hpp"
+#include "beacon_state.hpp"
 #include "bytelists.hpp"
 #include "concepts.hpp"
+#include "mapped_file.hpp"
 #include "ssz++.hpp"
+#include "stream.hpp"
 
 void test_basic_types() {
   TEST_CHECK(std::to_integer<std::uint8_t>(
@@ -101,8 +110,13 @@ void test_serialize_in_place() {
 
   // check we can use an array
   std::array<std::byte, 8> myarray{};
-  ssz::serialize(myarray.begin(), std::uint16_t{0xffee});
+  TEST_CHECK(ssz::serialize(myarray.begin(), std::uint16_t{0xffee}) == myarray.begin() + 2);
   TEST_CHECK(myarray[0] == std::byte{0xee});
+
+  // the end of the bytes written is returned
+  ssz::list<ssz::list<std::uint16_t, 8>, 4> lists{{std::vector<std::uint16_t>(3), std::vector<std::uint16_t>{}}};
+  std::vector<std::byte> buffer(ssz::size(lists));
+  TEST_CHECK(ssz::serialize(buffer.begin(), lists) == buffer.end());
 }
 void test_deserialize_basic_types() {
   std::vector<std::byte> bytes{
@@ -238,6 +252,13 @@ void test_deserialize_basic_list() {
   TEST_CHECK(result_bool_bitset == expected_bool_bitset);
 }
 
+// members serialized in the reverse order of their declaration
+struct reversed_container_t : ssz::ssz_container {
+  std::uint64_t a{};
+  std::uint64_t b{};
+  SSZ_CONT(b, a);
+};
+
 void test_list_of_vectors() {
   std::vector<std::array<std::uint64_t, 3>> vec{};
   vec.push_back({0xabcdef9901020304ull, 0x01ull, 0xaaaaull});
@@ -268,6 +289,22 @@ void test_list_of_vectors() {
 
   auto round = ssz::deserialize<std::vector<std::array<std::uint64_t, 3>>>(result);
   TEST_CHECK(round == vec);
+
+  // vectors of packed elements are copied as a whole
+  static_assert(ssz::packed_layout<std::array<std::uint64_t, 3>> && ssz::packed_layout<ssz::checkpoint_t>);
+  static_assert(!ssz::packed_layout<ssz::validator_t> && !ssz::packed_layout<reversed_container_t>);
+  ssz::list<ssz::checkpoint_t, 8> checkpoints{std::vector<ssz::checkpoint_t>(3)};
+  checkpoints[1].epoch = 5;
+  checkpoints[2].root[0] = std::byte{7};
+  auto checkpoint_bytes = ssz::serialize(checkpoints);
+  TEST_CHECK(checkpoint_bytes.size() == 120);
+  TEST_CHECK(checkpoint_bytes[40] == std::byte{5} && checkpoint_bytes[88] == std::byte{7});
+  TEST_CHECK((ssz::deserialize<ssz::list<ssz::checkpoint_t, 8>>(checkpoint_bytes) == checkpoints));
+  std::vector<reversed_container_t> reversed(2);
+  reversed[1].a = 1;
+  auto reversed_bytes = ssz::serialize(reversed);
+  TEST_CHECK(reversed_bytes[24] == std::byte{1});
+  TEST_CHECK(ssz::deserialize<std::vector<reversed_container_t>>(reversed_bytes)[1].a == 1);
 }
 
 struct my_container_t : ssz::ssz_container {
@@ -287,6 +324,11 @@ struct my_variable_container_t : ssz::ssz_variable_size_container {
 
 static_assert(ssz::ssz_object_variable_size<my_variable_container_t>);
 
+struct my_single_list_container_t : ssz::ssz_variable_size_container {
+  ssz::list<std::uint16_t, 8> vec{std::vector<std::uint16_t>{1, 2, 3}};
+  SSZ_CONT(vec);
+};
+
 void test_serialize_containers() {
   std::vector<std::byte> result{32};
   std::uint32_t a{3};
@@ -402,6 +444,19 @@ void test_deserialize_containers() {
   auto deserialized_variable = ssz::deserialize<my_variable_container_t>(expected_variable);
   TEST_CHECK(std::ranges::equal(my_vec, deserialized_variable.vec));
   TEST_CHECK(deserialized_variable.a == 5);
+
+  // fixed size containers know their layout at compile time
+  static_assert(ssz::validator_t::ssz_fixed_members && ssz::validator_t::ssz_fixed_part_size == 121);
+  static_assert(ssz::validator_t::ssz_member_positions[3] == 88);
+  static_assert(!ssz::attestation_t::ssz_fixed_members && ssz::attestation_t::ssz_member_positions[1] == 4);
+  ssz::validator_t validator{};
+  validator.slashed = true;
+  validator.exit_epoch = 17;
+  auto validator_bytes = ssz::serialize(validator);
+  TEST_CHECK(validator_bytes.size() == validator.ssz_size());
+  TEST_CHECK(ssz::deserialize<ssz::validator_t>(validator_bytes) == validator);
+  validator_bytes.pop_back();
+  TEST_EXCEPTION(ssz::deserialize<ssz::validator_t>(validator_bytes), std::invalid_argument);
 }
 void test_hextring_to_bytes() {
   auto hexstring = "0xff21";
@@ -414,6 +469,202 @@ void test_hextring_to_bytes() {
   TEST_CHECK(byte_vector[0] == std::byte{0xff});
   TEST_CHECK(byte_vector[1] == std::byte{0x21});
 }
+void test_views() {
+  auto block = std::make_unique<ssz::signed_beacon_block_t>();
+  block->message.slot = 42;
+  block->message.parent_root[3] = std::byte{0x17};
+  block->message.body.graffiti[0] = std::byte{0x01};
+  for (std::uint64_t i = 0; i < 3; i++) {
+    ssz::attestation_t attestation{};
+    attestation.aggregation_bits.data().resize(10 * i + 1);
+    attestation.data.slot = 40 + i;
+    block->message.body.attestations.push_back(attestation);
+  }
+  auto bytes = ssz::serialize(*block);
+  ssz::view<ssz::signed_beacon_block_t> signed_block{bytes};
+  auto message = signed_block.get<"message">();
+  TEST_CHECK(message.get<"slot">() == 42);
+  TEST_CHECK(message.get<0>() == 42);
+  TEST_CHECK(std::ranges::equal(message.get<"parent_root">().bytes(), block->message.parent_root));
+  auto body = message.get<"body">();
+  TEST_CHECK(body.get<"graffiti">().decode() == block->message.body.graffiti);
+  auto attestations = body.get<"attestations">();
+  TEST_CHECK(attestations.size() == 3);
+  for (std::size_t i = 0; i < 3; i++) {
+    TEST_CHECK(attestations[i].get<"data">().get<"slot">() == 40 + i);
+    auto bits = attestations[i].get<"aggregation_bits">().decode();
+    TEST_CHECK(bits == block->message.body.attestations[i].aggregation_bits);
+  }
+  TEST_EXCEPTION(attestations[3], std::out_of_range);
+  TEST_CHECK(body.get<"deposits">().size() == 0);
+  TEST_CHECK(message.decode() == block->message);
+  TEST_CHECK(signed_block.hash_tree_root() == ssz::hash_tree_root(*block));
+
+  // the offset of the body points past the end
+  bytes[ssz::_detail::fixed_part_size<ssz::signed_beacon_block_t>() + 83] = std::byte{0xff};
+  TEST_EXCEPTION(ssz::view<ssz::signed_beacon_block_t>{bytes}.get<"message">().get<"body">(), std::invalid_argument);
+  TEST_EXCEPTION(ssz::view<ssz::beacon_block_header_t>{bytes}, std::invalid_argument);
+}
+
+void test_mapped_file() {
+  auto block = std::make_unique<ssz::signed_beacon_block_t>();
+  block->message.slot = 7;
+  block->message.body.deposits.push_back(ssz::deposit_t{});
+  auto bytes = ssz::serialize(*block);
+  auto path = std::filesystem::temp_directory_path() / "ssz_mapped_file_test.ssz";
+  {
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+  auto loaded = ssz::deserialize_file<ssz::signed_beacon_block_t>(path);
+  TEST_CHECK(*loaded == *block);
+  ssz::mapped_file file{path, ssz::mapped_file::access::random, false};
+  TEST_CHECK(std::ranges::equal(file, bytes));
+  TEST_CHECK(ssz::view<ssz::signed_beacon_block_t>{file}.get<"message">().get<"slot">() == 7);
+  std::filesystem::remove(path);
+  TEST_EXCEPTION(ssz::mapped_file{path}, std::filesystem::filesystem_error);
+}
+
+void test_parallel_deserialize() {
+  auto state = std::make_unique<ssz::beacon_state_t>();
+  state->slot = 11;
+  state->validators.data().resize(3000);
+  state->balances.data().resize(3000);
+  for (std::uint64_t i = 0; i < 3000; i++) {
+    state->validators[i].effective_balance = i;
+    state->validators[i].slashed = i & 1;
+    state->balances[i] = 3 * i;
+  }
+  state->block_roots[5][0] = std::byte{0x2a};
+  auto bytes = ssz::serialize(*state);
+  for (std::size_t threads : {1, 3}) {
+    ssz::thread_pool::set_global_threads(threads);
+    for (std::size_t cpu_count : {0, 1, 2, 5}) {
+      auto decoded = std::make_unique<ssz::beacon_state_t>();
+      ssz::deserialize_parallel(bytes, *decoded, cpu_count);
+      TEST_CHECK(*decoded == *state);
+      TEST_MSG("Wrong state with %lu threads and cpu_count %lu", threads, cpu_count);
+    }
+  }
+  // the offset of the validators points past the end
+  bytes[ssz::_detail::member_position<ssz::beacon_state_t, 11>() + 3] = std::byte{0xff};
+  auto decoded = std::make_unique<ssz::beacon_state_t>();
+  TEST_EXCEPTION(ssz::deserialize_parallel(bytes, *decoded, 2), std::invalid_argument);
+}
+
+void test_parallel_serialize() {
+  auto state = std::make_unique<ssz::beacon_state_t>();
+  state->validators.data().resize(3000);
+  state->balances.data().resize(3000);
+  for (std::uint64_t i = 0; i < 3000; i++) {
+    state->validators[i].effective_balance = i;
+    state->balances[i] = 3 * i;
+  }
+  state->block_roots[5][0] = std::byte{0x2a};
+  state->justification_bits[1] = true;
+  auto bytes = ssz::serialize(*state);
+  for (std::size_t threads : {1, 3}) {
+    ssz::thread_pool::set_global_threads(threads);
+    for (std::size_t cpu_count : {0, 1, 2, 5}) {
+      TEST_CHECK(ssz::serialize_parallel(*state, cpu_count) == bytes);
+      TEST_MSG("Wrong serialization with %lu threads and cpu_count %lu", threads, cpu_count);
+      std::vector<std::byte> in_place(bytes.size());
+      ssz::serialize_parallel(in_place.begin(), *state, cpu_count);
+      TEST_CHECK(in_place == bytes);
+    }
+  }
+
+  // a container with a single variable size member still writes its offset
+  my_single_list_container_t single{};
+  auto single_bytes = ssz::serialize(single);
+  TEST_CHECK(single_bytes.size() == 10 && single_bytes[0] == std::byte{4} && single_bytes[4] == std::byte{1});
+  my_single_list_container_t single_decoded{};
+  single_decoded.vec = {};
+  ssz::deserialize(single_bytes, single_decoded);
+  TEST_CHECK(single_decoded == single);
+
+  // the members of a container are serialized one after another
+  ssz::voluntary_exit_t exit{};
+  exit.epoch = 3;
+  exit.validator_index = 5;
+  auto exit_bytes = ssz::serialize(exit);
+  TEST_CHECK(exit_bytes.size() == 16 && exit_bytes[0] == std::byte{3} && exit_bytes[8] == std::byte{5});
+  std::vector<std::byte> members(16);
+  ssz::serialize(members.begin(), exit.epoch, std::uint64_t{5});
+  TEST_CHECK(members == exit_bytes);
+}
+
+void test_streaming_serialization() {
+  auto state = std::make_unique<ssz::beacon_state_t>();
+  state->validators.data().resize(100);
+  state->balances.data().resize(100);
+  state->previous_epoch_participation.data().resize(100);
+  for (std::uint64_t i = 0; i < 100; i++) {
+    state->validators[i].effective_balance = i;
+    state->balances[i] = 3 * i;
+  }
+  state->justification_bits[1] = true;
+  auto bytes = ssz::serialize(*state);
+  for (std::size_t chunk_size : {1ul, 100ul, 4096ul, ssz::default_stream_chunk_size}) {
+    std::vector<std::byte> streamed{};
+    std::size_t largest{};
+    ssz::serialize_to(
+        [&](std::span<const std::byte> chunk) {
+          largest = std::max(largest, chunk.size());
+          streamed.insert(streamed.end(), chunk.begin(), chunk.end());
+        },
+        *state, chunk_size);
+    TEST_CHECK(streamed == bytes);
+    TEST_CHECK(largest <= chunk_size);
+    TEST_MSG("Wrong streamed serialization with chunks of %lu bytes", chunk_size);
+  }
+  std::ostringstream os{};
+  ssz::serialize_to(ssz::ostream_sink{os}, *state, 1000);
+  TEST_CHECK(os.str().size() == bytes.size());
+  TEST_CHECK(std::memcmp(os.str().data(), bytes.data(), bytes.size()) == 0);
+}
+
+void test_streaming_deserialization() {
+  auto state = std::make_unique<ssz::beacon_state_t>();
+  state->slot = 9;
+  state->validators.data().resize(100);
+  state->balances.data().resize(100);
+  for (std::uint64_t i = 0; i < 100; i++) {
+    state->validators[i].effective_balance = i;
+    state->validators[i].slashed = i & 1;
+    state->balances[i] = 3 * i;
+  }
+  state->historical_roots.data().resize(2);
+  state->justification_bits[1] = true;
+  auto bytes = ssz::serialize(*state);
+  for (std::size_t chunk_size : {1ul, 7ul, 4096ul, bytes.size()}) {
+    for (auto size : {bytes.size(), ssz::stream_decoder<ssz::beacon_state_t>::unknown_size}) {
+      auto decoded = std::make_unique<ssz::beacon_state_t>();
+      ssz::stream_decoder decoder{*decoded, size};
+      for (std::size_t pos = 0; pos < bytes.size(); pos += chunk_size)
+        decoder.feed(std::span<const std::byte>{bytes}.subspan(pos, std::min(chunk_size, bytes.size() - pos)));
+      TEST_CHECK(decoder.done() == (size == bytes.size()));
+      decoder.finish();
+      TEST_CHECK(*decoded == *state);
+      TEST_MSG("Wrong decoded state with chunks of %lu bytes", chunk_size);
+    }
+  }
+
+  // straight from the streaming serializer
+  auto decoded = std::make_unique<ssz::beacon_state_t>();
+  ssz::stream_decoder decoder{*decoded};
+  ssz::serialize_to([&](std::span<const std::byte> chunk) { decoder.feed(chunk); }, *state, 1000);
+  decoder.finish();
+  TEST_CHECK(*decoded == *state);
+
+  // a truncated validator and bytes past the declared size
+  ssz::stream_decoder truncated{*decoded};
+  truncated.feed(std::span<const std::byte>{bytes}.first(bytes.size() - 1));
+  TEST_EXCEPTION(truncated.finish(), std::invalid_argument);
+  ssz::stream_decoder sized{*decoded, bytes.size() - 1};
+  TEST_EXCEPTION(sized.feed(bytes), std::invalid_argument);
+}
+
 TEST_LIST{{"basic_types", test_basic_types},
           {"serialize_in_place", test_serialize_in_place},
           {"deserialize_basic_types", test_deserialize_basic_types},
@@ -425,4 +676,10 @@ TEST_LIST{{"basic_types", test_basic_types},
           {"serialize_containers", test_serialize_containers},
           {"deserialize_containers", test_deserialize_containers},
           {"hexstring_to_bytes", test_hextring_to_bytes},
+          {"views", test_views},
+          {"mapped_file", test_mapped_file},
+          {"parallel_deserialize", test_parallel_deserialize},
+          {"parallel_serialize", test_parallel_serialize},
+          {"streaming_serialization", test_streaming_serialization},
+          {"streaming_deserialization", test_streaming_deserialization},
           {NULL, NULL}};
@@ -0,0 +1,185 @@
+/*  snappy_test.cpp
+ *
+ *  This file is part of ssz++.
+ *  ssz++ is a C++ library implementing simple serialize
+ *  https://github.com/ethereum/consensus-specs/blob/dev/ssz/simple-serialize.md
+ *
+ *  Copyright (c) 2023 - Offchain Labs
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+
+ *  http://www.apache.org/licenses/LICENSE-2.0
+
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <random>
+
+#include "acutest.h"
+#include "beacon_state.hpp"
+#include "ssz++.hpp"
+#include "ssz_snappy.hpp"
+
+namespace {
+using state_t = ssz::beacon_state_t;
+
+struct blob_t : ssz::ssz_variable_size_container {
+    ssz::list<std::byte, 1 << 20> data;
+
+    bool operator==(const blob_t &) const = default;
+
+    SSZ_CONT(data);
+};
+
+auto bytes_of(std::initializer_list<int> values) {
+    std::vector<std::byte> ret{};
+    for (auto v : values) ret.push_back(std::byte(v));
+    return ret;
+}
+
+auto random_state(std::mt19937_64 &gen) {
+    auto state = std::make_unique<state_t>();
+    std::vector<ssz::validator_t> validators(1000);
+    for (auto &v : validators) {
+        v.pubkey[0] = std::byte(gen());
+        v.effective_balance = gen() % 32;
+    }
+    state->validators.reset(validators);
+    std::vector<ssz::Gwei> balances(1000);
+    std::ranges::generate(balances, gen);
+    state->balances.reset(balances);
+    state->block_roots[77][0] = std::byte(gen());
+    return state;
+}
+
+template <class T>
+auto deserialize_framed_in_chunks(std::span<const std::byte> compressed, std::size_t chunk_size) {
+    auto ret = std::make_unique<T>();
+    ssz::stream_decoder<T> decoder{*ret};
+    auto feed = [&](std::span<const std::byte> chunk) { decoder.feed(chunk); };
+    ssz::snappy_frame_decoder frames{feed};
+    for (std::size_t pos = 0; pos < compressed.size(); pos += chunk_size)
+        frames.feed(compressed.subspan(pos, std::min(chunk_size, compressed.size() - pos)));
+    frames.finish();
+    decoder.finish();
+    return ret;
+}
+}  // namespace
+
+void test_raw_format() {
+    std::mt19937_64 gen{1};
+    auto state = random_state(gen);
+    auto bytes = ssz::serialize(*state);
+    auto compressed = ssz::serialize_snappy(*state);
+    TEST_CHECK(compressed.size() < bytes.size());
+
+    // the output is a valid snappy block
+    std::vector<std::byte> uncompressed(bytes.size());
+    TEST_CHECK(snappy::RawUncompress(reinterpret_cast<const char *>(compressed.data()), compressed.size(),
+                                     reinterpret_cast<char *>(uncompressed.data())));
+    TEST_CHECK(uncompressed == bytes);
+
+    auto decoded = std::make_unique<state_t>();
+    ssz::deserialize_snappy(compressed, *decoded);
+    TEST_CHECK(*decoded == *state);
+
+    compressed.resize(compressed.size() / 2);
+    TEST_EXCEPTION(ssz::deserialize_snappy(compressed, *decoded), std::invalid_argument);
+}
+
+void test_raw_elements() {
+    // a literal, a copy with a one byte offset, a literal with its length in an extra byte, a copy with a two bytes
+    // offset and an overlapping copy with a four bytes offset
+    auto compressed = bytes_of({40,   0x0c, 1, 2, 3, 4, 0x01, 4, 0xf0, 7, 0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6,
+                                0xa7, 0x1e, 8, 0, 0x3f, 1,    0, 0,    0});
+    auto expected = bytes_of({1, 2, 3, 4, 1, 2, 3, 4});
+    auto literal = bytes_of({0xa0, 0xa1, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7});
+    expected.insert(expected.end(), literal.begin(), literal.end());
+    expected.insert(expected.end(), literal.begin(), literal.end());
+    expected.insert(expected.end(), 16, std::byte{0xa7});
+    ssz::checkpoint_t checkpoint{};
+    ssz::deserialize_snappy(compressed, checkpoint);
+    TEST_CHECK(ssz::serialize(checkpoint) == expected);
+
+    auto zero_offset = compressed;
+    zero_offset[7] = std::byte{0};
+    TEST_EXCEPTION(ssz::deserialize_snappy(zero_offset, checkpoint), std::invalid_argument);
+
+    // a copy further back than a block is decoded by decompressing everything first
+    std::mt19937_64 gen{3};
+    blob_t blob{};
+    for (std::size_t i = 0; i < 139996; i++) blob.data.push_back(std::byte(gen()));
+    auto serialized = ssz::serialize(blob);
+    auto far = bytes_of({0xe4, 0xc5, 0x08, 0xf8, 0xdf, 0x22, 0x02});
+    far.insert(far.end(), serialized.begin(), serialized.end());
+    auto copy = bytes_of({0x0f, 0xe0, 0x22, 0x02, 0});
+    far.insert(far.end(), copy.begin(), copy.end());
+    serialized.insert(serialized.end(), serialized.begin(), serialized.begin() + 4);
+    blob_t decoded{};
+    ssz::deserialize_snappy(far, decoded);
+    TEST_CHECK(ssz::serialize(decoded) == serialized);
+}
+
+void test_framed_format() {
+    std::mt19937_64 gen{2};
+    auto state = random_state(gen);
+    auto compressed = ssz::serialize_snappy_framed(*state);
+    TEST_CHECK(compressed.size() < ssz::size(*state));
+
+    auto decoded = std::make_unique<state_t>();
+    ssz::deserialize_snappy_framed(compressed, *decoded);
+    TEST_CHECK(*decoded == *state);
+    for (std::size_t chunk_size : {1ul, 1000ul, 100000ul}) {
+        TEST_CHECK(*deserialize_framed_in_chunks<state_t>(compressed, chunk_size) == *state);
+        TEST_MSG("Wrong state with chunks of %lu bytes", chunk_size);
+    }
+
+    // a checksum mismatch in the first data chunk, and a truncated stream
+    auto corrupted = compressed;
+    corrupted[15] ^= std::byte{1};
+    TEST_EXCEPTION(ssz::deserialize_snappy_framed(corrupted, *decoded), std::invalid_argument);
+    compressed.pop_back();
+    TEST_EXCEPTION(ssz::deserialize_snappy_framed(compressed, *decoded), std::invalid_argument);
+}
+
+void test_known_streams() {
+    // streams written by hand from the format descriptions, independent of the snappy library: the CRC-32C check value,
+    // masked, and a checkpoint whose serialization has no repeated bytes, which snappy encodes as a single literal
+    auto digits = bytes_of({'1', '2', '3', '4', '5', '6', '7', '8', '9'});
+    TEST_CHECK(ssz::_detail::masked_crc32c(digits) == 0xc78ab0e5);
+    auto serialized = bytes_of({7, 0, 0, 0, 0, 0, 0, 0});
+    for (int i = 1; i <= 32; i++) serialized.push_back(std::byte(i));
+    auto block = bytes_of({40, 0x9c});
+    block.insert(block.end(), serialized.begin(), serialized.end());
+    ssz::checkpoint_t checkpoint{};
+    ssz::deserialize_snappy(block, checkpoint);
+    TEST_CHECK(ssz::serialize(checkpoint) == serialized);
+
+    auto identifier = bytes_of({0xff, 6, 0, 0, 's', 'N', 'a', 'P', 'p', 'Y'});
+    auto framed_output = ssz::serialize_snappy_framed(checkpoint);
+    TEST_CHECK(std::ranges::equal(std::span{framed_output}.first(identifier.size()), identifier));
+    // the same bytes in an uncompressed chunk and in a compressed one
+    for (const auto &[type, payload] : {std::pair{0x01, serialized}, std::pair{0x00, block}}) {
+        auto framed = identifier;
+        auto length = static_cast<int>(payload.size()) + 4;
+        auto header = bytes_of({type, length, 0, 0, 0x11, 0x79, 0x77, 0x3b});
+        framed.insert(framed.end(), header.begin(), header.end());
+        framed.insert(framed.end(), payload.begin(), payload.end());
+        ssz::checkpoint_t decoded{};
+        ssz::deserialize_snappy_framed(framed, decoded);
+        TEST_CHECK(decoded == checkpoint);
+        TEST_MSG("Wrong checkpoint from a chunk of type %d", type);
+    }
+}
+
+TEST_LIST{{"raw_format", test_raw_format},
+          {"raw_elements", test_raw_elements},
+          {"framed_format", test_framed_format},
+          {"known_streams", test_known_streams},
+          {NULL, NULL}};
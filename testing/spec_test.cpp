@@ -32,7 +32,7 @@
 #include "exits.hpp"
 #include "historical_summary.hpp"
 #include "ssz++.hpp"
-#include "snappy.h"
+#include "ssz_snappy.hpp"
 #include "sync_committee.hpp"
 #include "withdrawals.hpp"
 #include "validator.hpp"
@@ -61,13 +61,13 @@ void do_test(const auto &case_dir) {
     auto serialized_bytes = ssz::serialize(decoded);
     auto deserialized = ssz::deserialize<T>(serialized_bytes);
     TEST_CHECK(deserialized == decoded);
-    std::vector<std::byte> ssz_output(serialized_bytes.size());
-    if (!snappy::RawUncompress(reinterpret_cast<char *>(ssz_content.data()), ssz_snappy_size,
-                               reinterpret_cast<char *>(ssz_output.data())))
-        throw std::filesystem::filesystem_error("could not uncompress file", case_dir.path(), std::error_code());
 
-    auto deserialized_snappy = ssz::deserialize<T>(ssz_output);
+    T deserialized_snappy{};
+    ssz::deserialize_snappy(ssz_content, deserialized_snappy);
     TEST_CHECK(deserialized_snappy == decoded);
+    T roundtrip{};
+    ssz::deserialize_snappy_framed(ssz::serialize_snappy_framed(decoded), roundtrip);
+    TEST_CHECK(roundtrip == decoded);
 
     auto node_root = YAML::LoadFile(case_dir.path().string() + "/roots.yaml");
     auto root = node_root["root"].template as<ssz::chunk_t>();
@@ -91,14 +91,10 @@ void do_test_heap(const auto &case_dir) {
     ssz_snappy.close();
 
     auto serialized_bytes = ssz::serialize(*decoded_ptr);
-    std::vector<std::byte> ssz_output(serialized_bytes.size());
-    if (!snappy::RawUncompress(reinterpret_cast<char *>(ssz_content.data()), ssz_snappy_size,
-                               reinterpret_cast<char *>(ssz_output.data())))
-        throw std::filesystem::filesystem_error("could not uncompress file", case_dir.path(), std::error_code());
-
     std::unique_ptr<T> deserialized_ptr(ssz::deserialize<T *>(serialized_bytes));
     TEST_CHECK(*deserialized_ptr == *decoded_ptr);
-    auto deserialized_snappy_ptr = std::make_unique<T>(ssz::deserialize<T>(ssz_output));
+    auto deserialized_snappy_ptr = std::make_unique<T>();
+    ssz::deserialize_snappy(ssz_content, *deserialized_snappy_ptr);
     TEST_CHECK(*deserialized_snappy_ptr == *decoded_ptr);
 
     auto node_root = YAML::LoadFile(case_dir.path().string() + "/roots.yaml");